@@ -0,0 +1,137 @@
+#include "arena.h"
+#include <cassert>
+
+namespace arena {
+
+    bumpArena::bumpArena(size_t block_size) : block_size(block_size) {
+        // a block must be able to hold at least one aligned object
+        assert(block_size >= alignof(std::max_align_t));
+    }
+
+    bumpArena::~bumpArena() {
+        reset();
+    }
+
+    char* bumpArena::allocate(size_t bytes) {
+        // zero-byte allocation is meaningless
+        assert(bytes > 0);
+
+        // fast path, just bump the pointer
+        if (bytes <= alloc_bytes_remaining) {
+            char* result = alloc_ptr;
+            alloc_ptr += bytes;
+            alloc_bytes_remaining -= bytes;
+            return result;
+        }
+
+        return allocateFallback(bytes);
+    }
+
+    char* bumpArena::allocateAligned(size_t bytes, size_t align) {
+        // align must be a power of 2
+        assert((align & (align - 1)) == 0);
+
+        size_t current_mod = reinterpret_cast<uintptr_t>(alloc_ptr) & (align - 1);
+        size_t slop = (current_mod == 0 ? 0 : align - current_mod);
+        size_t needed = bytes + slop;
+
+        // fast path, the current block is enough
+        if (needed <= alloc_bytes_remaining) {
+            char* result = alloc_ptr + slop;
+            alloc_ptr += needed;
+            alloc_bytes_remaining -= needed;
+            return result;
+        }
+
+        // memory returned by operator new is always aligned to max_align_t
+        assert(align <= alignof(std::max_align_t));
+        return allocateFallback(bytes);
+    }
+
+    // the bytes of a shared block start after its header, and each reservation is rounded
+    // to the granule, so they all start aligned to it
+    static const size_t shared_granule = alignof(uint64_t);
+    static const size_t shared_header_size = alignof(std::max_align_t);
+
+    static size_t roundUp(size_t bytes, size_t align) {
+        return (bytes + align - 1) & ~(align - 1);
+    }
+
+    char* bumpArena::allocateConcurrently(size_t bytes, size_t align) {
+        // align must be a power of 2 no larger than what operator new gives
+        assert((align & (align - 1)) == 0 && align <= alignof(std::max_align_t));
+
+        // a large object gets its own block, which the lock is only taken for
+        size_t reserved = roundUp(bytes + (align > shared_granule ? align - shared_granule : 0), 
+            shared_granule);
+        if (reserved > block_size / 4) {
+            std::lock_guard<std::mutex> lock(alloc_mutex);
+            return allocateNewBlock(bytes);
+        }
+
+        while (true) {
+            // fast path, reserve the bytes in the current block without any lock
+            sharedBlock* block = shared_block.load(std::memory_order_acquire);
+            if (block) {
+                size_t offset = block->used.fetch_add(reserved, std::memory_order_relaxed);
+                if (offset + reserved <= block->size) {
+                    char* start = reinterpret_cast<char*>(block) + shared_header_size + offset;
+                    return reinterpret_cast<char*>(roundUp(reinterpret_cast<uintptr_t>(start), 
+                        align));
+                }
+            }
+
+            // the block is full, so the first writer seeing it replaces it
+            replaceSharedBlock(block);
+        }
+    }
+
+    void bumpArena::replaceSharedBlock(sharedBlock* full_block) {
+        std::lock_guard<std::mutex> lock(alloc_mutex);
+        if (shared_block.load(std::memory_order_relaxed) != full_block) return;
+
+        // the rest of the full block is wasted
+        char* mem = allocateNewBlock(shared_header_size + block_size);
+        sharedBlock* block = new (mem) sharedBlock;
+        block->used.store(0, std::memory_order_relaxed);
+        block->size = block_size;
+        shared_block.store(block, std::memory_order_release);
+    }
+
+    char* bumpArena::allocateFallback(size_t bytes) {
+        // a large object gets its own block, so that the current block isn't wasted
+        if (bytes > block_size / 4) {
+            return allocateNewBlock(bytes);
+        }
+
+        // waste the remaining space of the current block
+        alloc_ptr = allocateNewBlock(block_size);
+        alloc_bytes_remaining = block_size;
+
+        char* result = alloc_ptr;
+        alloc_ptr += bytes;
+        alloc_bytes_remaining -= bytes;
+        return result;
+    }
+
+    char* bumpArena::allocateNewBlock(size_t block_bytes) {
+        char* result = new char[block_bytes];
+        blocks.push_back(result);
+        memory_usage += block_bytes + sizeof(char*);
+        return result;
+    }
+
+    void bumpArena::reset() {
+        // only one free for each block instead of one for each object
+        for (char* block : blocks) {
+            delete [] block;
+        }
+        blocks.clear();
+
+        alloc_ptr = nullptr;
+        alloc_bytes_remaining = 0;
+        shared_block = nullptr;
+        memory_usage = 0;
+    }
+
+}
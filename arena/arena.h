@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace arena {
+
+    // the size of one ordinary block allocated from the system
+    const size_t default_block_size = 4096;
+
+    // a bump allocator whose memory is only released all at once
+    class bumpArena
+    {
+    private:
+        size_t block_size;
+
+        // the current block and the bytes left in it
+        char* alloc_ptr = nullptr;
+        size_t alloc_bytes_remaining = 0;
+
+        // all blocks allocated from the system
+        std::vector<char*> blocks;
+        std::atomic<size_t> memory_usage = 0;
+
+        // the block concurrent writers bump, whose header at its start counts the bytes
+        // reserved by fetch_add, which may go beyond the block once it's full
+        struct sharedBlock {
+            std::atomic<size_t> used;
+            size_t size;
+        };
+        std::atomic<sharedBlock*> shared_block = nullptr;
+
+        // taken only to allocate blocks when the arena is shared by several writers
+        std::mutex alloc_mutex;
+
+        char* allocateFallback(size_t bytes);
+        char* allocateNewBlock(size_t block_bytes);
+        void replaceSharedBlock(sharedBlock* full_block);
+
+    public:
+        explicit bumpArena(size_t block_size = default_block_size);
+        ~bumpArena();
+
+        bumpArena(const bumpArena&) = delete;
+        bumpArena& operator=(const bumpArena&) = delete;
+
+        char* allocate(size_t bytes);
+        char* allocateAligned(size_t bytes, size_t align = alignof(std::max_align_t));
+
+        // thread-safe version of allocateAligned, which is lock-free unless a new block is
+        // needed, ATTENTION! don't mix it with the others
+        char* allocateConcurrently(size_t bytes, size_t align = alignof(std::max_align_t));
+
+        // construct an object inside the arena, ATTENTION! its destructor is never called
+        template <typename T, typename... Args>
+        T* create(Args&&... args) {
+            char* mem = allocateAligned(sizeof(T), alignof(T));
+            return new (mem) T(std::forward<Args>(args)...);
+        }
+
+        // release all blocks in one shot
+        void reset();
+
+        size_t memoryUsage() const { return memory_usage.load(std::memory_order_relaxed); }
+    };
+
+}
@@ -0,0 +1,249 @@
+#include "bPlusTree.h"
+#include <algorithm>
+
+namespace bplustree {
+
+    bplustree_type::bplustree_type() {
+        root = pool.create<leafNode>();
+    }
+
+    bplustree_type::~bplustree_type() {
+        // all nodes are released together with the arena
+    }
+
+    const char* bplustree_type::newValue(value_view val) {
+        // the old value is abandoned in the arena until the arena is reset
+        uint32_t length = static_cast<uint32_t>(val.length());
+        char* record = pool.allocateAligned(sizeof(length) + length, alignof(uint32_t));
+        memcpy(record, &length, sizeof(length));
+        memcpy(record + sizeof(length), val.data(), length);
+        return record;
+    }
+
+    std::optional<bplustree_type::splitResult> bplustree_type::insert(void* node, size_t level,
+        const key_type& key, const char* value) {
+        // already the leaf
+        if (level == depth) {
+            return insertIntoLeaf(static_cast<leafNode*>(node), key, value);
+        }
+
+        // find the child which may hold the key
+        innerNode* inner = static_cast<innerNode*>(node);
+        size_t index = std::upper_bound(inner->keys, inner->keys + inner->count, key) - inner->keys;
+        auto split = insert(inner->children[index], level + 1, key, value);
+
+        // the child has been split, so the separator goes up
+        if (split.has_value()) {
+            return insertIntoInner(inner, index, split.value());
+        }
+        return std::nullopt;
+    }
+
+    std::optional<bplustree_type::splitResult> bplustree_type::insertIntoLeaf(leafNode* leaf,
+        const key_type& key, const char* value) {
+        size_t pos = std::lower_bound(leaf->keys, leaf->keys + leaf->count, key) - leaf->keys;
+
+        // if replace is allowed, replace old value with new value
+        if (pos < leaf->count && leaf->keys[pos] == key) {
+            leaf->values[pos] = value;
+            return std::nullopt;
+        }
+
+        // there's still room in the leaf
+        if (leaf->count < leaf_capacity) {
+            std::copy_backward(leaf->keys + pos, leaf->keys + leaf->count,
+                leaf->keys + leaf->count + 1);
+            std::copy_backward(leaf->values + pos, leaf->values + leaf->count,
+                leaf->values + leaf->count + 1);
+            leaf->keys[pos] = key;
+            leaf->values[pos] = value;
+            ++leaf->count;
+            ++key_number;
+            return std::nullopt;
+        }
+
+        // move the upper half into a new leaf
+        leafNode* right = pool.create<leafNode>();
+        size_t half = leaf_capacity / 2;
+        right->count = static_cast<uint32_t>(leaf_capacity - half);
+        std::copy(leaf->keys + half, leaf->keys + leaf_capacity, right->keys);
+        std::copy(leaf->values + half, leaf->values + leaf_capacity, right->values);
+        leaf->count = static_cast<uint32_t>(half);
+        right->next = leaf->next;
+        leaf->next = right;
+
+        // insert into the half where the key belongs, neither of them is full now
+        if (pos <= half) insertIntoLeaf(leaf, key, value);
+        else insertIntoLeaf(right, key, value);
+
+        return splitResult{ right->keys[0], right };
+    }
+
+    std::optional<bplustree_type::splitResult> bplustree_type::insertIntoInner(innerNode* inner,
+        size_t index, const splitResult& split) {
+        // there's still room in the node
+        if (inner->count < inner_capacity) {
+            std::copy_backward(inner->keys + index, inner->keys + inner->count,
+                inner->keys + inner->count + 1);
+            std::copy_backward(inner->children + index + 1, inner->children + inner->count + 1,
+                inner->children + inner->count + 2);
+            inner->keys[index] = split.key;
+            inner->children[index + 1] = split.node;
+            ++inner->count;
+            return std::nullopt;
+        }
+
+        // lay out all keys and children as if the node were large enough
+        key_type keys[inner_capacity + 1];
+        void* children[inner_capacity + 2];
+        std::copy(inner->keys, inner->keys + index, keys);
+        keys[index] = split.key;
+        std::copy(inner->keys + index, inner->keys + inner_capacity, keys + index + 1);
+        std::copy(inner->children, inner->children + index + 1, children);
+        children[index + 1] = split.node;
+        std::copy(inner->children + index + 1, inner->children + inner_capacity + 1,
+            children + index + 2);
+
+        // the middle key goes up, and the upper half moves into a new node
+        size_t mid = (inner_capacity + 1) / 2;
+        innerNode* right = pool.create<innerNode>();
+        inner->count = static_cast<uint32_t>(mid);
+        std::copy(keys, keys + mid, inner->keys);
+        std::copy(children, children + mid + 1, inner->children);
+        right->count = static_cast<uint32_t>(inner_capacity - mid);
+        std::copy(keys + mid + 1, keys + inner_capacity + 1, right->keys);
+        std::copy(children + mid + 1, children + inner_capacity + 2, right->children);
+
+        return splitResult{ keys[mid], right };
+    }
+
+    const leafNode* bplustree_type::findLeaf(const key_type& key) const {
+        const void* node = root;
+        for (size_t level = 0; level < depth; ++level) {
+            const innerNode* inner = static_cast<const innerNode*>(node);
+            size_t index = std::upper_bound(inner->keys, inner->keys + inner->count, key)
+                - inner->keys;
+            node = inner->children[index];
+        }
+        return static_cast<const leafNode*>(node);
+    }
+
+    void bplustree_type::put(const key_type& key, value_view val) {
+        insertRecord(key, newValue(val));
+    }
+
+    void bplustree_type::remove(const key_type& key) {
+        insertRecord(key, nullptr);
+    }
+
+    void bplustree_type::insertRecord(const key_type& key, const char* record) {
+        auto split = insert(root, 0, key, record);
+
+        // the root has been split, so the tree grows by one level
+        if (split.has_value()) {
+            innerNode* new_root = pool.create<innerNode>();
+            new_root->count = 1;
+            new_root->keys[0] = split->key;
+            new_root->children[0] = root;
+            new_root->children[1] = split->node;
+            root = new_root;
+            ++depth;
+        }
+    }
+
+    std::optional<entry_type> bplustree_type::get(const key_type& key) const {
+        const leafNode* leaf = findLeaf(key);
+        size_t pos = std::lower_bound(leaf->keys, leaf->keys + leaf->count, key) - leaf->keys;
+
+        // if find the right key
+        if (pos < leaf->count && leaf->keys[pos] == key) {
+            entry_view entry = leaf->getEntry(pos);
+            return entry_type{ entry.kind, value_type(entry.value) };
+        }
+
+        // return the default value of value_type
+        return std::nullopt;
+    }
+
+    void bplustree_type::clear() {
+        // release all nodes in one shot
+        pool.reset();
+        key_number = 0;
+
+        depth = 0;
+        root = pool.create<leafNode>();
+    }
+
+    size_t bplustree_type::size() const {
+        return key_number;
+    }
+
+    bplustree_type::const_iterator::const_iterator(const leafNode* leaf, size_t index)
+        : leaf(leaf), index(index) {
+        // an index past the end of a leaf means the first key of the next leaf
+        while (this->leaf && this->index >= this->leaf->count) {
+            this->leaf = this->leaf->next;
+            this->index = 0;
+        }
+    }
+
+    bplustree_type::const_iterator& bplustree_type::const_iterator::operator++() {
+        if (!leaf) {
+            throw exception::iterator_null();
+        }
+
+        *this = const_iterator(leaf, index + 1);
+        return *this;
+    }
+
+    bplustree_type::const_iterator bplustree_type::const_iterator::operator++(int) {
+        if (!leaf) {
+            throw exception::iterator_null();
+        }
+
+        bplustree_type::const_iterator old_it = *this;
+        *this = const_iterator(leaf, index + 1);
+        return old_it;
+    }
+
+    entry_view bplustree_type::const_iterator::operator*() const {
+        return leaf->getEntry(index);
+    }
+
+    value_view bplustree_type::const_iterator::value() const {
+        return leaf->getEntry(index).value;
+    }
+
+    const key_type& bplustree_type::const_iterator::key() const {
+        return leaf->keys[index];
+    }
+
+    bool bplustree_type::const_iterator::operator==(const const_iterator& other) const {
+        return leaf == other.leaf && index == other.index;
+    }
+
+    bool bplustree_type::const_iterator::operator!=(const const_iterator& other) const {
+        return !(*this == other);
+    }
+
+    bplustree_type::const_iterator bplustree_type::cbegin() const {
+        // the leftmost leaf
+        const void* node = root;
+        for (size_t level = 0; level < depth; ++level) {
+            node = static_cast<const innerNode*>(node)->children[0];
+        }
+        return const_iterator(static_cast<const leafNode*>(node), 0);
+    }
+
+    bplustree_type::const_iterator bplustree_type::cend() const {
+        return const_iterator();
+    }
+
+    bplustree_type::const_iterator bplustree_type::lower_bound(const key_type& key) const {
+        // the key is either in this leaf or the first one of the next leaf
+        const leafNode* leaf = findLeaf(key);
+        size_t pos = std::lower_bound(leaf->keys, leaf->keys + leaf->count, key) - leaf->keys;
+        return const_iterator(leaf, pos);
+    }
+
+} // namespace bplustree
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include "../arena/arena.h"
+#include "../common/definitions.h"
+#include "../common/exceptions.h"
+
+namespace bplustree {
+
+    using key_type = def::key_type;
+    using value_type = def::value_type;
+    using value_view = def::value_view;
+    using entry_type = def::entry_type;
+    using entry_view = def::entry_view;
+
+    // the number of keys a node holds, chosen so that a leaf spans a few cache lines
+    const size_t leaf_capacity = 32;
+    const size_t inner_capacity = 32;
+
+    // leaves hold all keys and are linked for ordered iteration
+    struct leafNode {
+        uint32_t count = 0;
+        key_type keys[leaf_capacity];
+
+        // value records in the arena: a uint32_t length followed by the bytes,
+        // or nullptr for a tombstone
+        const char* values[leaf_capacity];
+        leafNode* next = nullptr;
+
+        entry_view getEntry(size_t index) const {
+            return def::recordEntry(values[index]);
+        }
+    };
+
+    // inner nodes only route searching, children[i] holds keys less than keys[i]
+    struct innerNode {
+        uint32_t count = 0;
+        key_type keys[inner_capacity];
+        void* children[inner_capacity + 1];
+    };
+
+    // ATTENTION! all nodes and values live in the arena, and no key is ever removed,
+    // which is all a memTable needs; the tree isn't safe for concurrent writers
+    class bplustree_type
+    {
+    private:
+        // the root is a leaf when depth == 0
+        void* root = nullptr;
+        size_t depth = 0;
+
+        size_t key_number = 0;
+
+        // nodes and values are all allocated here
+        arena::bumpArena pool;
+
+        // the result of splitting a node: the separator key and the new right node
+        struct splitResult {
+            key_type key;
+            void* node;
+        };
+
+        // method members of bplustree here
+        const char* newValue(value_view val);
+        void insertRecord(const key_type& key, const char* record);
+        std::optional<splitResult> insert(void* node, size_t level,
+            const key_type& key, const char* value);
+        std::optional<splitResult> insertIntoLeaf(leafNode* leaf,
+            const key_type& key, const char* value);
+        std::optional<splitResult> insertIntoInner(innerNode* inner, size_t index,
+            const splitResult& split);
+        const leafNode* findLeaf(const key_type& key) const;
+
+    public:
+        bplustree_type();
+        ~bplustree_type();
+
+        void put(const key_type& key, value_view val);
+        std::optional<entry_type> get(const key_type& key) const;
+
+        // a tombstone takes no space for the value
+        void remove(const key_type& key);
+
+        void clear();
+
+        size_t size() const;
+        size_t memoryUsage() const { return pool.memoryUsage(); }
+
+        class const_iterator
+        {
+        private:
+            const leafNode* leaf = nullptr;
+            size_t index = 0;
+
+        public:
+            const_iterator(const leafNode* leaf = nullptr, size_t index = 0);
+            const_iterator& operator++();
+            const_iterator operator++(int);
+            entry_view operator*() const;
+
+            value_view value() const;
+            const key_type& key() const;
+
+            bool operator==(const const_iterator& other) const;
+            bool operator!=(const const_iterator& other) const;
+        };
+
+        const_iterator cbegin() const;
+        const_iterator cend() const;
+
+        // the first element whose key is not less than 'key'
+        const_iterator lower_bound(const key_type& key) const;
+    };
+
+} // namespace bplustree
@@ -1,31 +1,111 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include "MurmurHash3.h"
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 namespace bloomfilter {
 
+    // what a SSTable asks before reading its data
+    template <typename T>
+    class keyFilter
+    {
+    public:
+        virtual ~keyFilter() = default;
+
+        virtual bool query(const T& key) const = 0;
+
+        // copy the bytes a filter reads in place, so it no longer needs them
+        virtual void own() = 0;
+    };
+
     template <typename T>
-    class bloomFilter
+    class bloomFilter : public keyFilter<T>
     {
     private:
         size_t byte_count, bit_count, k;
         unsigned char* hash_array;
 
+        // a filter reading the bytes of another one in place doesn't own them
+        bool owned = true;
+
     public:
-        bloomFilter(size_t m, size_t k = 1);
+        // m bytes and k probe bits for each key, every 4 of which take one Murmur hash
+        bloomFilter(size_t m, size_t k = 4);
+        // ATTENTION! the m bytes at src are read in place, and must outlive the filter
+        bloomFilter(const unsigned char* src, size_t m, size_t k);
         ~bloomFilter();
 
+        bloomFilter(const bloomFilter&) = delete;
+        bloomFilter& operator=(const bloomFilter&) = delete;
+
         void insert(const T& key);
-        bool query(const T& key) const;
+        bool query(const T& key) const override;
         void clear();
         void set(const unsigned char* src);
+        void own() override;
 
         const unsigned char* getContent() const { return hash_array; }
     };
 
+    // all probe bits of a key fall into one 64-byte block, one bit in each of its words
+    // from 8 salted multiplies, which is the split block bloom filter, so a probe touches
+    // a single cache line and is checked with SIMD compares
+    //
+    // filters written before all words were used set only the first k words, and are
+    // read with the k in their tables
+    template <typename T>
+    class blockedBloomFilter : public keyFilter<T>
+    {
+    private:
+        static constexpr size_t block_words = 8;
+        struct alignas(64) block_type {
+            uint64_t words[block_words];
+        };
+
+        size_t block_count, k;
+
+        // the blocks allocated by the filter, which is null for one reading them in place,
+        // and the words it reads from either
+        block_type* blocks = nullptr;
+        uint64_t* words;
+
+        // the block and the bits in it are both taken from one hash
+        uint64_t* locate(const T& key, uint32_t& bits_hash) const;
+
+    public:
+        // m bytes are rounded up to whole blocks, and k words take a bit of each key, which
+        // are all words of a block except in older filters
+        explicit blockedBloomFilter(size_t m, size_t k = block_words);
+        // ATTENTION! the m bytes at src are read in place, and must outlive the filter and
+        // be aligned to words
+        blockedBloomFilter(const unsigned char* src, size_t m, size_t k);
+        ~blockedBloomFilter();
+
+        blockedBloomFilter(const blockedBloomFilter&) = delete;
+        blockedBloomFilter& operator=(const blockedBloomFilter&) = delete;
+
+        void insert(const T& key);
+        bool query(const T& key) const override;
+        void clear();
+        void set(const unsigned char* src);
+        void own() override;
+
+        // the same as query without SIMD, which it's checked against
+        bool queryScalar(const T& key) const;
+
+        static size_t maxHashes() { return block_words; }
+        static size_t blockSize() { return sizeof(block_type); }
+        const unsigned char* getContent() const { return (const unsigned char*)words; }
+        size_t size() const { return block_count * sizeof(block_type); }
+    };
+
 }
 
 // below is the implementation of bloomFilter
@@ -36,40 +116,43 @@ namespace bloomfilter {
         this->hash_array = new unsigned char[byte_count]{};
     }
 
+    template <typename T>
+    bloomFilter<T>::bloomFilter(const unsigned char* src, size_t m, size_t k) 
+        : byte_count(m), bit_count(m << 3), k(k), 
+        hash_array(const_cast<unsigned char*>(src)), owned(false) {}
+
     template <typename T>
     bloomFilter<T>::~bloomFilter<T>() {
-        delete [] hash_array;
+        if (owned) delete [] hash_array;
     }
 
     template <typename T>
     void bloomFilter<T>::insert(const T &key) {
+        uint32_t hash[4] = {};
         for (uint32_t i = 0; i < k; ++i) {
-            uint32_t hash[4];
-            // calculate hash value
-            MurmurHash3_x64_128(&key, sizeof(key), i, hash);
-            for (uint32_t j = 0; j < 4; ++j) {
-                // calculate for the position
-                size_t bits = hash[j] % bit_count;
-                size_t byte_no = bits / 8, bit_no = bits % 8;
-                // insert into the array
-                hash_array[byte_no] |= 1 << bit_no;
-            }
+            // calculate hash value, which gives 4 probes
+            if (i % 4 == 0) MurmurHash3_x64_128(&key, sizeof(key), i / 4, hash);
+            // calculate for the position
+            size_t bits = hash[i % 4] % bit_count;
+            size_t byte_no = bits / 8, bit_no = bits % 8;
+            // insert into the array, bits may be set by several writers at the same time
+            __atomic_fetch_or(&hash_array[byte_no], 
+                static_cast<unsigned char>(1 << bit_no), __ATOMIC_RELAXED);
         }
     }
 
     template <typename T>
     bool bloomFilter<T>::query(const T &key) const {
+        uint32_t hash[4] = {};
         for (uint32_t i = 0; i < k; ++i) {
-            uint32_t hash[4];
-            // calculate hash value
-            MurmurHash3_x64_128(&key, sizeof(key), i, hash);
-            for (uint32_t j = 0; j < 4; ++j) {
-                // calculate for the position
-                size_t bits = hash[j] % bit_count;
-                size_t byte_no = bits / 8, bit_no = bits % 8;
-                // the value in the hash array is 0
-                if (!((hash_array[byte_no] >> bit_no) & 1)) return false;
-            }
+            // calculate hash value, which gives 4 probes
+            if (i % 4 == 0) MurmurHash3_x64_128(&key, sizeof(key), i / 4, hash);
+            // calculate for the position
+            size_t bits = hash[i % 4] % bit_count;
+            size_t byte_no = bits / 8, bit_no = bits % 8;
+            // the value in the hash array is 0
+            unsigned char byte = __atomic_load_n(&hash_array[byte_no], __ATOMIC_RELAXED);
+            if (!((byte >> bit_no) & 1)) return false;
         }
 
         // all is 1, but may be mistaken
@@ -86,4 +169,141 @@ namespace bloomfilter {
         memcpy(hash_array, src, byte_count);
     }
 
+    template <typename T>
+    void bloomFilter<T>::own() {
+        if (owned) return;
+        unsigned char* copy = new unsigned char[byte_count];
+        memcpy(copy, hash_array, byte_count);
+        hash_array = copy;
+        owned = true;
+    }
+
+
+    // the salts spreading one hash over the words of a block, which are odd numbers
+    // taken from the split block bloom filter of Parquet
+    static const uint32_t block_salts[8] = {
+        0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+        0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+    };
+
+    // whether blocked bloom filters are probed with AVX2, which is checked at runtime, so
+    // a build for any x86-64 CPU uses it where it's there
+    inline bool simdProbe() {
+#if defined(__x86_64__)
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    // stop at the first missing bit, which is where most absent keys end
+    inline bool probeBlock(const uint64_t* words, uint32_t bits_hash, size_t k) {
+        for (size_t i = 0; i < k; ++i) {
+            uint64_t mask = 1ull << ((bits_hash * block_salts[i]) >> 26);
+            if (!(__atomic_load_n(&words[i], __ATOMIC_RELAXED) & mask)) return false;
+        }
+        return true;
+    }
+
+#if defined(__x86_64__)
+    // compute the 8 bit positions at once, widen them to 64-bit lanes, drop the words
+    // beyond k, and test each half of the block against its masks
+    __attribute__((target("avx2")))
+    inline bool probeBlockAvx2(const uint64_t* words, uint32_t bits_hash, size_t k) {
+        const __m256i salts = _mm256_loadu_si256((const __m256i*)block_salts);
+        __m256i positions = _mm256_srli_epi32(
+            _mm256_mullo_epi32(_mm256_set1_epi32(bits_hash), salts), 26);
+        __m256i used = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(k)), 
+            _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        const __m256i ones = _mm256_set1_epi64x(1);
+        __m256i low_mask = _mm256_and_si256(_mm256_sllv_epi64(ones, 
+            _mm256_cvtepu32_epi64(_mm256_castsi256_si128(positions))), 
+            _mm256_cvtepi32_epi64(_mm256_castsi256_si128(used)));
+        __m256i high_mask = _mm256_and_si256(_mm256_sllv_epi64(ones, 
+            _mm256_cvtepu32_epi64(_mm256_extracti128_si256(positions, 1))), 
+            _mm256_cvtepi32_epi64(_mm256_extracti128_si256(used, 1)));
+        const __m256i* block = (const __m256i*)words;
+        // a block read in place in a file may not be aligned to its size
+        return _mm256_testc_si256(_mm256_loadu_si256(block), low_mask) &&
+            _mm256_testc_si256(_mm256_loadu_si256(block + 1), high_mask);
+    }
+#endif
+
+    template <typename T>
+    blockedBloomFilter<T>::blockedBloomFilter(size_t m, size_t k) 
+        : block_count(std::max<size_t>((m + sizeof(block_type) - 1) / sizeof(block_type), 1)), 
+        k(std::clamp<size_t>(k, 1, block_words)) {
+        this->blocks = new block_type[block_count]{};
+        this->words = blocks->words;
+    }
+
+    template <typename T>
+    blockedBloomFilter<T>::blockedBloomFilter(const unsigned char* src, size_t m, size_t k) 
+        : block_count(std::max<size_t>(m / sizeof(block_type), 1)), 
+        k(std::clamp<size_t>(k, 1, block_words)), 
+        words(reinterpret_cast<uint64_t*>(const_cast<unsigned char*>(src))) {}
+
+    template <typename T>
+    blockedBloomFilter<T>::~blockedBloomFilter<T>() {
+        delete [] blocks;
+    }
+
+    template <typename T>
+    uint64_t* blockedBloomFilter<T>::locate(const T& key, uint32_t& bits_hash) const {
+        uint64_t hash[2];
+        MurmurHash3_x64_128(&key, sizeof(key), 0, hash);
+
+        // map the hash onto the blocks with a multiplication instead of a modulo
+        bits_hash = static_cast<uint32_t>(hash[1]);
+        return words + (((hash[0] >> 32) * block_count) >> 32) * block_words;
+    }
+
+    template <typename T>
+    void blockedBloomFilter<T>::insert(const T& key) {
+        uint32_t bits_hash;
+        uint64_t* block = locate(key, bits_hash);
+        for (size_t i = 0; i < k; ++i) {
+            // the highest 6 bits choose one of the 64 bits in the word
+            uint64_t mask = 1ull << ((bits_hash * block_salts[i]) >> 26);
+            // bits may be set by several writers at the same time
+            __atomic_fetch_or(&block[i], mask, __ATOMIC_RELAXED);
+        }
+    }
+
+    template <typename T>
+    bool blockedBloomFilter<T>::query(const T& key) const {
+        uint32_t bits_hash;
+        const uint64_t* block = locate(key, bits_hash);
+#if defined(__x86_64__)
+        if (simdProbe()) return probeBlockAvx2(block, bits_hash, k);
+#endif
+        return probeBlock(block, bits_hash, k);
+    }
+
+    template <typename T>
+    bool blockedBloomFilter<T>::queryScalar(const T& key) const {
+        uint32_t bits_hash;
+        const uint64_t* block = locate(key, bits_hash);
+        return probeBlock(block, bits_hash, k);
+    }
+
+    template <typename T>
+    void blockedBloomFilter<T>::clear() {
+        memset(words, 0, size());
+    }
+
+    template <typename T>
+    void blockedBloomFilter<T>::set(const unsigned char* src) {
+        memcpy(words, src, size());
+    }
+
+    template <typename T>
+    void blockedBloomFilter<T>::own() {
+        if (blocks) return;
+        blocks = new block_type[block_count];
+        memcpy(blocks, words, size());
+        words = blocks->words;
+    }
+
 }
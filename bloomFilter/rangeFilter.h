@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "bloomFilter.h"
+
+namespace bloomfilter {
+
+    // tells whether any key may be in a range with a blocked bloom filter over the prefixes
+    // of the keys, which drop the lowest shift bits, so a short range is answered by
+    // probing each prefix it covers, and a long one is always a maybe
+    template <typename T>
+    class prefixRangeFilter
+    {
+        static_assert(std::is_unsigned_v<T>, "prefixes are taken from unsigned keys");
+
+    private:
+        // a range covering more prefixes than this isn't worth probing
+        static constexpr size_t max_probes = 16;
+
+        size_t shift;
+        blockedBloomFilter<T> prefixes;
+
+    public:
+        // m bytes and k words taken by each prefix in the blocks of the bloom filter
+        prefixRangeFilter(size_t m, size_t k, size_t shift);
+        // ATTENTION! the m bytes at src are read in place like those of blockedBloomFilter
+        prefixRangeFilter(const unsigned char* src, size_t m, size_t k, size_t shift);
+
+        // the shift which leaves about one key in each prefix
+        static size_t shiftFor(const T& min_key, const T& max_key, size_t n);
+
+        void insert(const T& key) { prefixes.insert(key >> shift); }
+        bool query(const T& key1, const T& key2) const;
+        void set(const unsigned char* src) { prefixes.set(src); }
+        void own() { prefixes.own(); }
+
+        const unsigned char* getContent() const { return prefixes.getContent(); }
+        size_t size() const { return prefixes.size(); }
+    };
+
+}
+
+// below is the implementation of prefixRangeFilter
+namespace bloomfilter {
+
+    template <typename T>
+    prefixRangeFilter<T>::prefixRangeFilter(size_t m, size_t k, size_t shift)
+        : shift(std::min(shift, sizeof(T) * 8 - 1)), prefixes(m, k) {}
+
+    template <typename T>
+    prefixRangeFilter<T>::prefixRangeFilter(const unsigned char* src, size_t m, size_t k, 
+        size_t shift) : shift(std::min(shift, sizeof(T) * 8 - 1)), prefixes(src, m, k) {}
+
+    template <typename T>
+    size_t prefixRangeFilter<T>::shiftFor(const T& min_key, const T& max_key, size_t n) {
+        // the average gap between keys
+        T gap = n ? (max_key - min_key) / n : 0;
+        size_t result = 0;
+        while (gap >>= 1) ++result;
+        return result;
+    }
+
+    template <typename T>
+    bool prefixRangeFilter<T>::query(const T& key1, const T& key2) const {
+        T first = key1 >> shift, last = key2 >> shift;
+        if (last - first >= max_probes) return true;
+
+        for (T prefix = first; ; ++prefix) {
+            if (prefixes.query(prefix)) return true;
+            if (prefix == last) return false;
+        }
+    }
+
+}
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "MurmurHash3.h"
+#include "bloomFilter.h"
+
+namespace bloomfilter {
+
+    // a static filter built once from all keys, which stores a fingerprint of f bits in
+    // about 1.23 slots for each key, and a key is there if the xor of its 3 slots is
+    // its fingerprint, so the false positive rate is 2^-f with 3 memory accesses
+    template <typename T>
+    class xorFilter : public keyFilter<T>
+    {
+    private:
+        // the content starts with the seed and the length of each of the 3 blocks of
+        // slots, and the fingerprints are packed after it
+        struct header_type {
+            uint64_t seed;
+            uint32_t block_length;
+            uint32_t reserved;
+        };
+
+        // a fingerprint is read as 4 bytes, which may go beyond the last one
+        static constexpr size_t padding_size = sizeof(uint32_t);
+        static constexpr size_t max_build_attempts = 64;
+
+        size_t byte_count, fingerprint_bits;
+        uint32_t fingerprint_mask;
+        unsigned char* content;
+
+        // a filter reading the bytes of another one in place doesn't own them
+        bool owned = true;
+
+        // copies of the header for queries
+        uint64_t seed = 0;
+        uint32_t block_length = 0;
+
+        unsigned char* fingerprints() const { return content + sizeof(header_type); }
+
+        uint64_t hash(const T& key) const;
+        void slots(uint64_t key_hash, uint32_t result[3]) const;
+        uint32_t fingerprint(uint64_t key_hash) const;
+        uint32_t getSlot(uint32_t slot) const;
+        void setSlot(uint32_t slot, uint32_t value);
+
+    public:
+        // m bytes of content with fingerprints of f bits, which is within [1, 16]
+        xorFilter(size_t m, size_t f);
+        // ATTENTION! the m bytes at src are read in place, and must outlive the filter
+        xorFilter(const unsigned char* src, size_t m, size_t f);
+        ~xorFilter();
+
+        xorFilter(const xorFilter&) = delete;
+        xorFilter& operator=(const xorFilter&) = delete;
+
+        // the bytes of content for n keys with fingerprints of f bits
+        static size_t bytesFor(size_t n, size_t f);
+
+        // ATTENTION! the keys must be distinct, and the filter is sized by bytesFor,
+        // which returns false if no seed makes the keys peelable
+        bool build(const std::vector<T>& keys);
+
+        bool query(const T& key) const override;
+        void set(const unsigned char* src);
+        void own() override;
+
+        const unsigned char* getContent() const { return content; }
+        size_t size() const { return byte_count; }
+    };
+
+}
+
+// below is the implementation of xorFilter
+namespace bloomfilter {
+
+    template <typename T>
+    xorFilter<T>::xorFilter(size_t m, size_t f)
+        : byte_count(std::max(m, sizeof(header_type) + padding_size)),
+        fingerprint_bits(std::clamp<size_t>(f, 1, 16)),
+        fingerprint_mask((1u << fingerprint_bits) - 1) {
+        this->content = new unsigned char[byte_count]{};
+    }
+
+    template <typename T>
+    xorFilter<T>::xorFilter(const unsigned char* src, size_t m, size_t f)
+        : byte_count(m), fingerprint_bits(std::clamp<size_t>(f, 1, 16)),
+        fingerprint_mask((1u << fingerprint_bits) - 1), 
+        content(const_cast<unsigned char*>(src)), owned(false) {
+        header_type header;
+        memcpy(&header, content, sizeof(header));
+        seed = header.seed;
+        block_length = header.block_length;
+    }
+
+    template <typename T>
+    xorFilter<T>::~xorFilter<T>() {
+        if (owned) delete [] content;
+    }
+
+    template <typename T>
+    size_t xorFilter<T>::bytesFor(size_t n, size_t f) {
+        // 1.23 slots for each key make peeling succeed almost always
+        size_t block_length = (n * 123 / 100 + 32 + 2) / 3;
+        f = std::clamp<size_t>(f, 1, 16);
+        return sizeof(header_type) + (3 * block_length * f + 7) / 8 + padding_size;
+    }
+
+    template <typename T>
+    uint64_t xorFilter<T>::hash(const T& key) const {
+        uint64_t hash[2];
+        MurmurHash3_x64_128(&key, sizeof(key), static_cast<uint32_t>(seed), hash);
+        return hash[0];
+    }
+
+    template <typename T>
+    void xorFilter<T>::slots(uint64_t key_hash, uint32_t result[3]) const {
+        // each slot is taken from different bits of the hash, mapped onto its block
+        // with a multiplication instead of a modulo
+        for (uint32_t i = 0; i < 3; ++i) {
+            uint32_t bits = static_cast<uint32_t>(
+                (key_hash << (21 * i)) | (i ? key_hash >> (64 - 21 * i) : 0));
+            result[i] = static_cast<uint32_t>(((uint64_t)bits * block_length) >> 32) +
+                i * block_length;
+        }
+    }
+
+    template <typename T>
+    uint32_t xorFilter<T>::fingerprint(uint64_t key_hash) const {
+        return static_cast<uint32_t>(key_hash ^ (key_hash >> 32)) & fingerprint_mask;
+    }
+
+    template <typename T>
+    uint32_t xorFilter<T>::getSlot(uint32_t slot) const {
+        size_t bit = (size_t)slot * fingerprint_bits;
+        uint32_t word;
+        memcpy(&word, fingerprints() + bit / 8, sizeof(word));
+        return (word >> (bit % 8)) & fingerprint_mask;
+    }
+
+    template <typename T>
+    void xorFilter<T>::setSlot(uint32_t slot, uint32_t value) {
+        size_t bit = (size_t)slot * fingerprint_bits;
+        uint32_t word;
+        memcpy(&word, fingerprints() + bit / 8, sizeof(word));
+        word &= ~(fingerprint_mask << (bit % 8));
+        word |= (value & fingerprint_mask) << (bit % 8);
+        memcpy(fingerprints() + bit / 8, &word, sizeof(word));
+    }
+
+    template <typename T>
+    bool xorFilter<T>::build(const std::vector<T>& keys) {
+        size_t n = keys.size();
+        block_length = static_cast<uint32_t>((n * 123 / 100 + 32 + 2) / 3);
+        size_t capacity = 3 * (size_t)block_length;
+        if (sizeof(header_type) + (capacity * fingerprint_bits + 7) / 8 + padding_size >
+            byte_count) return false;
+
+        // the number of keys in each slot and the xor of their hashes, so the only key
+        // of a slot is known without a list
+        std::vector<uint32_t> counts(capacity);
+        std::vector<uint64_t> xors(capacity);
+        std::vector<uint32_t> queue;
+        std::vector<std::pair<uint64_t, uint32_t>> stack;
+        queue.reserve(capacity);
+        stack.reserve(n);
+
+        bool peeled = false;
+        for (size_t attempt = 0; attempt < max_build_attempts && !peeled; ++attempt) {
+            seed = attempt;
+            std::fill(counts.begin(), counts.end(), 0);
+            std::fill(xors.begin(), xors.end(), 0);
+            queue.clear();
+            stack.clear();
+
+            uint32_t key_slots[3];
+            for (const T& key : keys) {
+                uint64_t key_hash = hash(key);
+                slots(key_hash, key_slots);
+                for (uint32_t slot : key_slots) {
+                    ++counts[slot];
+                    xors[slot] ^= key_hash;
+                }
+            }
+
+            // peel the keys which are alone in a slot, and that slot is theirs
+            for (uint32_t slot = 0; slot < capacity; ++slot) {
+                if (counts[slot] == 1) queue.push_back(slot);
+            }
+            while (!queue.empty()) {
+                uint32_t slot = queue.back();
+                queue.pop_back();
+                if (counts[slot] != 1) continue;
+
+                uint64_t key_hash = xors[slot];
+                stack.emplace_back(key_hash, slot);
+                slots(key_hash, key_slots);
+                for (uint32_t other : key_slots) {
+                    xors[other] ^= key_hash;
+                    if (--counts[other] == 1) queue.push_back(other);
+                }
+            }
+            peeled = stack.size() == n;
+        }
+        if (!peeled) return false;
+
+        // assign in the reverse order, so the other slots of a key are final by then
+        memset(content, 0, byte_count);
+        for (auto it = stack.rbegin(), eit = stack.rend(); it != eit; ++it) {
+            uint32_t key_slots[3];
+            slots(it->first, key_slots);
+            uint32_t value = fingerprint(it->first);
+            for (uint32_t slot : key_slots) {
+                if (slot != it->second) value ^= getSlot(slot);
+            }
+            setSlot(it->second, value);
+        }
+
+        header_type header{ seed, block_length, 0 };
+        memcpy(content, &header, sizeof(header));
+        return true;
+    }
+
+    template <typename T>
+    bool xorFilter<T>::query(const T& key) const {
+        uint64_t key_hash = hash(key);
+        uint32_t key_slots[3];
+        slots(key_hash, key_slots);
+        return fingerprint(key_hash) ==
+            (getSlot(key_slots[0]) ^ getSlot(key_slots[1]) ^ getSlot(key_slots[2]));
+    }
+
+    template <typename T>
+    void xorFilter<T>::set(const unsigned char* src) {
+        memcpy(content, src, byte_count);
+
+        header_type header;
+        memcpy(&header, content, sizeof(header));
+        seed = header.seed;
+        block_length = header.block_length;
+    }
+
+    template <typename T>
+    void xorFilter<T>::own() {
+        if (owned) return;
+        unsigned char* copy = new unsigned char[byte_count];
+        memcpy(copy, content, byte_count);
+        content = copy;
+        owned = true;
+    }
+
+}
@@ -0,0 +1,130 @@
+#include <cstring>
+#include "checksum.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace checksum {
+
+    // the reflected polynomial of CRC-32C
+    static const uint32_t polynomial = 0x82f63b78;
+
+    // the bytes each of the 3 streams takes at once, where the long ones hide the latency
+    // of the instruction for large values and the short ones for the rest of them
+    static const size_t long_block_size = 8192, short_block_size = 256;
+
+    static uint64_t load64(const unsigned char* src) {
+        uint64_t word;
+        memcpy(&word, src, sizeof(word));
+        return word;
+    }
+
+    // a * b modulo the polynomial, where both are reflected and x^0 is the highest bit
+    static uint32_t multiplyModulo(uint32_t a, uint32_t b) {
+        uint32_t m = 1u << 31, product = 0;
+        while (true) {
+            if (a & m) {
+                product ^= b;
+                if (!(a & (m - 1))) break;
+            }
+            m >>= 1;
+            b = b & 1 ? (b >> 1) ^ polynomial : b >> 1;
+        }
+        return product;
+    }
+
+    // x^(8 * n) modulo the polynomial, which shifts a crc over n zero bytes
+    static uint32_t zeroBytesOperator(size_t n) {
+        uint32_t result = 1u << 31, power = 1u << 30;
+        for (size_t bits = n * 8; bits; bits >>= 1) {
+            if (bits & 1) result = multiplyModulo(power, result);
+            power = multiplyModulo(power, power);
+        }
+        return result;
+    }
+
+    struct sliceTables {
+        uint32_t table[8][256];
+
+        sliceTables() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; ++bit) crc = crc & 1 ? (crc >> 1) ^ polynomial : crc >> 1;
+                table[0][i] = crc;
+            }
+            for (size_t k = 1; k < 8; ++k) {
+                for (size_t i = 0; i < 256; ++i) {
+                    table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+                }
+            }
+        }
+    };
+
+    // each table moves the crc over one more byte, so 8 bytes take 8 lookups at once
+    static uint32_t crc32cSoftware(const unsigned char* src, size_t length, uint32_t crc) {
+        static const sliceTables tables;
+        const auto& table = tables.table;
+        for (; length >= 8; src += 8, length -= 8) {
+            uint64_t word = load64(src) ^ crc;
+            crc = table[7][word & 0xff] ^ table[6][(word >> 8) & 0xff] ^
+                table[5][(word >> 16) & 0xff] ^ table[4][(word >> 24) & 0xff] ^
+                table[3][(word >> 32) & 0xff] ^ table[2][(word >> 40) & 0xff] ^
+                table[1][(word >> 48) & 0xff] ^ table[0][word >> 56];
+        }
+        for (; length; ++src, --length) crc = (crc >> 8) ^ table[0][(crc ^ *src) & 0xff];
+        return crc;
+    }
+
+#if defined(__x86_64__)
+    // the streams of a block are joined by shifting the crc of one over the next
+    __attribute__((target("sse4.2")))
+    static uint32_t crc32cBlocks(const unsigned char*& src, size_t& length, uint32_t crc,
+        size_t block_size, uint32_t shift) {
+        for (; length >= 3 * block_size; src += 3 * block_size, length -= 3 * block_size) {
+            uint64_t crc0 = crc, crc1 = 0, crc2 = 0;
+            for (size_t i = 0; i < block_size; i += 8) {
+                crc0 = _mm_crc32_u64(crc0, load64(src + i));
+                crc1 = _mm_crc32_u64(crc1, load64(src + block_size + i));
+                crc2 = _mm_crc32_u64(crc2, load64(src + 2 * block_size + i));
+            }
+            crc = multiplyModulo(shift, static_cast<uint32_t>(crc0)) ^ static_cast<uint32_t>(crc1);
+            crc = multiplyModulo(shift, crc) ^ static_cast<uint32_t>(crc2);
+        }
+        return crc;
+    }
+
+    __attribute__((target("sse4.2")))
+    static uint32_t crc32cHardware(const unsigned char* src, size_t length, uint32_t crc) {
+        static const uint32_t long_shift = zeroBytesOperator(long_block_size);
+        static const uint32_t short_shift = zeroBytesOperator(short_block_size);
+
+        crc = crc32cBlocks(src, length, crc, long_block_size, long_shift);
+        crc = crc32cBlocks(src, length, crc, short_block_size, short_shift);
+        uint64_t crc64 = crc;
+        for (; length >= 8; src += 8, length -= 8) crc64 = _mm_crc32_u64(crc64, load64(src));
+        crc = static_cast<uint32_t>(crc64);
+        for (; length; ++src, --length) crc = _mm_crc32_u8(crc, *src);
+        return crc;
+    }
+#endif
+
+    bool hardwareAccelerated() {
+#if defined(__x86_64__)
+        static const bool supported = __builtin_cpu_supports("sse4.2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    uint32_t crc32c(const void* data, size_t length, uint32_t crc) {
+        // the register starts and ends inverted
+        const unsigned char* src = static_cast<const unsigned char*>(data);
+#if defined(__x86_64__)
+        if (hardwareAccelerated()) return ~crc32cHardware(src, length, ~crc);
+#endif
+        return ~crc32cSoftware(src, length, ~crc);
+    }
+
+}
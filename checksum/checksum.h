@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace checksum {
+
+    // CRC-32C (Castagnoli) of the bytes, which continues from crc, the result over the
+    // bytes before them, so an entry is checked in pieces without joining them
+    //
+    // it runs on the crc32 instruction of SSE4.2 if the CPU has it, over 3 interleaved
+    // streams for long inputs, and on slice-by-8 tables otherwise
+    uint32_t crc32c(const void* data, size_t length, uint32_t crc = 0);
+
+    // whether crc32c runs on the instruction
+    bool hardwareAccelerated();
+
+}
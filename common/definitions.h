@@ -5,7 +5,9 @@
 #include <deque>
 #include <filesystem>
 #include <string>
+#include <string_view>
 #include <cstring>
+#include <vector>
 
 namespace sstable {
     // weak definition for sstable::SSTable
@@ -17,30 +19,119 @@ namespace def {
     // types of key and value
     using key_type = uint64_t;
     using value_type = std::string;
+    using value_view = std::string_view;
 
-    // tag representing deleted element
-    const value_type delete_tag = "~DELETED~";
+    // what a key maps to: a value, or a tombstone which has no value at all
+    enum class entry_kind : uint8_t {
+        value,
+        tombstone,
+    };
+
+    // an entry owning its value
+    struct entry_type {
+        entry_kind kind = entry_kind::value;
+        value_type value;
+
+        bool isTombstone() const { return kind == entry_kind::tombstone; }
+    };
 
-    // charactor representing start
-    const unsigned char start_sign = 0xff;
+    // an entry viewing its value somewhere else
+    struct entry_view {
+        entry_kind kind = entry_kind::value;
+        value_view value;
 
-    // class vLog has a fixed-size part and a dynamic-size part
-    const size_t v_log_fixed_size = sizeof(unsigned char) + sizeof(uint16_t) 
+        bool isTombstone() const { return kind == entry_kind::tombstone; }
+    };
+
+    // a value record in an arena is a uint32_t length followed by the bytes,
+    // while a tombstone has no record, which is nullptr
+    inline entry_view recordEntry(const char* record) {
+        if (!record) return entry_view{ entry_kind::tombstone, value_view() };
+
+        uint32_t length;
+        memcpy(&length, record, sizeof(length));
+        return entry_view{ entry_kind::value, value_view(record + sizeof(length), length) };
+    }
+
+    // charactor representing start, which also tells the version of the entry, where an
+    // entry written before crc32c is checked by crc16, and a compressed value has its own
+    const unsigned char start_sign = 0xfe;
+    const unsigned char crc16_start_sign = 0xff;
+    const unsigned char compressed_start_sign = 0xfd;
+
+    // class vLog has a fixed-size part and a dynamic-size part, and the fixed part of an
+    // entry checked by crc16 is 2 bytes shorter, while that of a compressed value is
+    // followed by the length before compression and the codec
+    const size_t v_log_fixed_size = sizeof(unsigned char) + sizeof(uint32_t) 
         + sizeof(key_type) + sizeof(uint32_t);
+    const size_t crc16_v_log_fixed_size = sizeof(unsigned char) + sizeof(uint16_t) 
+        + sizeof(key_type) + sizeof(uint32_t);
+    const size_t compressed_v_log_fixed_size = v_log_fixed_size + sizeof(uint32_t) 
+        + sizeof(uint8_t);
 
     // extension name of SSTable
     const std::string sstable_extension_name = ".sst";
 
+    // directory and extension name of write-ahead logs
+    const std::string wal_directory_name = "wal";
+    const std::string wal_extension_name = ".log";
+
+    // name of the log of version edits, and the extension of its rewritten copy
+    const std::string manifest_file_name = "MANIFEST";
+    const std::string manifest_temp_extension_name = ".tmp";
+
+    // the manifest is rewritten once it's this much larger than twice its snapshot
+    const size_t min_manifest_rewrite_size = 64 * 1024;
+
     // base name of directories storing sstable
     const std::string sstable_base_directory_name = "level-";
 
     // the header of SSTable
     struct ssTableHeader {
         uint64_t time;
-        uint64_t key_value_pair_number;
+        uint32_t key_value_pair_number;
+
+        // the format of the table, which takes the upper half of what used to be a 64-bit
+        // key_value_pair_number, so it's always 0 for tables written before it exists
+        uint32_t flags;
+
         def::key_type min_key, max_key;
     };
 
+    // the lowest 4 bits of ssTableHeader::flags are the type of the filter
+    const uint32_t sstable_filter_mask = 0xf;
+
+    // the filter is sized for its table, and the header is followed by a uint32_t size
+    // and a uint32_t number of hashes before the filter, otherwise it's legacy_filter_size
+    // bytes of bloom filter with legacy_filter_hashes
+    const uint32_t sstable_sized_filter_flag = 0x10;
+
+    // the filter is followed by a range filter, which is a uint32_t size, a uint32_t number
+    // of hashes and a uint32_t shift of prefixes before the prefix bloom filter
+    const uint32_t sstable_range_filter_flag = 0x20;
+
+    // the data starts at an offset aligned for ssTableData, after padding if needed,
+    // so it's read in place from the mapping of the file
+    const uint32_t sstable_aligned_data_flag = 0x40;
+
+    // the table is written in blocks, whose data is followed by an index of the blocks
+    // and a footer instead of one array of data, so a lookup only reads one block
+    const uint32_t sstable_block_format_flag = 0x80;
+
+    // the data blocks are bit-packed over bases of each block, see sstable::packedBlockHeader
+    const uint32_t sstable_packed_block_flag = 0x100;
+
+    // the index is followed by the segments of a learned index over the first keys of the
+    // blocks, whose number is in the footer
+    const uint32_t sstable_learned_index_flag = 0x200;
+
+    // each block starts with a blockCompressionHeader, and the rest of it is compressed
+    // with the codec there, which may be none if the block doesn't shrink
+    const uint32_t sstable_compressed_block_flag = 0x400;
+
+    // the positions a learned index may predict away from the right one
+    const size_t learned_index_error = 8;
+
     // the data of SSTable
     struct ssTableData {
         key_type key;
@@ -48,13 +139,64 @@ namespace def {
         uint32_t value_length;
     };
 
-    // max number of keys stored in the memory
-    const size_t max_file_size = 16 * 1024;
-    const size_t sstable_header_size = sizeof(ssTableHeader);
+    // a small value is stored in SSTable itself instead of vLog, which is marked by the
+    // highest bit of value_length, and its offset is relative to the inline values
+    const uint32_t inline_value_flag = 1u << 31;
+
+    inline bool isInlineValue(const ssTableData& data) {
+        return data.value_length & inline_value_flag;
+    }
+
+    inline uint32_t valueLength(const ssTableData& data) {
+        return data.value_length & ~inline_value_flag;
+    }
+
+    // a tombstone has neither an inline value nor a value in vLog, while an empty value
+    // is always inline to be told apart from it
+    inline bool isTombstone(const ssTableData& data) {
+        return !data.value_length;
+    }
+
+    // the filter of tables written before filters are sized, which is also the least
+    // size of the filter of a memTable
     const size_t bloom_filter_size = 8192;
+    const size_t legacy_filter_hashes = 4;
+
+    // the bits a filter may take for each key, whose false positive rate is then
+    // far below the cost of reading the table
+    const size_t max_filter_bits_per_key = 24;
+
+    const size_t sstable_header_size = sizeof(ssTableHeader);
+    const size_t sstable_filter_header_size = 2 * sizeof(uint32_t);
     const size_t sstable_data_size = sizeof(ssTableData);
-    const size_t max_key_number = (max_file_size - sstable_header_size - 
-        bloom_filter_size) / sstable_data_size;
+
+    // an entry of the index of a block-based table, which tells where a data block is
+    // and its first key, and a block is its data followed by their inline values
+    struct ssTableBlockHandle {
+        key_type first_key;
+        uint64_t offset;
+        uint32_t size;
+        uint32_t key_value_pair_number;
+    };
+
+    // the start of a block of a table with compressed blocks, which keeps the data after
+    // it aligned, and the codec takes the values of compression_type
+    struct blockCompressionHeader {
+        uint32_t raw_size;
+        uint8_t compression;
+        uint8_t reserved[3];
+    };
+
+    // the end of a block-based table, which tells where the index is, and the number of
+    // segments of the learned index after it, which is 0 for tables written before it
+    struct ssTableFooter {
+        uint64_t index_offset;
+        uint32_t block_number;
+        uint32_t segment_number;
+        uint64_t magic;
+    };
+    const uint64_t sstable_footer_magic = 0x6b76626c6f636b31;     // "kvblock1"
+    const size_t sstable_footer_size = sizeof(ssTableFooter);
 
     // the number of bytes scanned once when initializing vLog
     const size_t v_log_initialization_check_size = 1000;
@@ -62,19 +204,71 @@ namespace def {
     // the content of one SSTable
     struct ssTableContent {
         def::ssTableHeader header;
-        unsigned char bloomFilterContent[bloom_filter_size];
-        def::ssTableData data[max_key_number];
+        std::vector<def::ssTableData> data;
+
+        // the filter and the number of its hashes, which are sized by the level
+        std::string filter_content;
+        uint32_t filter_hashes = 0;
+
+        // the range filter, which is only there with sstable_range_filter_flag
+        std::string range_filter_content;
+        uint32_t range_filter_hashes = 0, range_filter_shift = 0;
+
+        // inline values follow the data in the file
+        std::string inline_values;
+
+        // returns the offset of the value among inline values
+        uint64_t appendInlineValue(std::string_view value) {
+            uint64_t offset = inline_values.size();
+            inline_values.append(value);
+            return offset;
+        }
+
+        std::string_view inlineValue(const ssTableData& data) const {
+            return std::string_view(inline_values).substr(data.offset, valueLength(data));
+        }
+
+        // the bytes of the data and the inline values, which decide when a table is full
+        size_t dataSize() const {
+            return data.size() * sstable_data_size + inline_values.size();
+        }
+    };
+
+    // a pair found in SSTable, whose value is only set when it's inline
+    struct ssTableEntry {
+        ssTableData data;
+        value_type value;
     };
 
     // the entry content of vLog
     struct vLogEntry {
         unsigned char start;
-        uint16_t cycSum;
+        uint32_t cycSum;
         key_type key;
         uint32_t value_length;
+
+        // a compressed value takes value_length bytes in vLog, and raw_length after it's
+        // decompressed with the codec
+        uint32_t raw_length;
+        uint8_t compression;
         value_type value;
     };
 
+    // the size of the fixed part of a vLog entry starting with the sign, which is 0 if
+    // it isn't a start sign
+    inline size_t vLogFixedSize(unsigned char start) {
+        switch (start) {
+        case start_sign:
+            return v_log_fixed_size;
+        case crc16_start_sign:
+            return crc16_v_log_fixed_size;
+        case compressed_start_sign:
+            return compressed_v_log_fixed_size;
+        default:
+            return 0;
+        }
+    }
+
     // a function to read something from buffer
     inline void read_from_buffer(char* dst, char* src, size_t size, size_t& pos) {
         memcpy((char*)dst, src + pos, size);
@@ -124,4 +318,20 @@ namespace def {
 
     // the number of levels that allow cache exists
     const size_t cached_levels = 4;
+
+    // a cached table keeps its keys in memory if there're at most so many, which are the
+    // keys of a table filled up to the target size, while older larger ones search blocks
+    inline size_t maxCachedKeyNumber(size_t sstable_target_size) {
+        return sstable_target_size / sstable_data_size + 1;
+    }
+
+    // the number of full memTables allowed to wait for flushing before writers stall
+    const size_t max_immutable_number = 2;
+
+    // the writers of keys hashed into the same stripe are logged and applied one by one
+    const size_t write_stripe_number = 64;
+
+    // a memTable uses one byte of bloom filter for every so many bytes of its budget,
+    // which is about 8 bits for each of the smallest entries
+    const size_t memtable_filter_ratio = 32;
 }
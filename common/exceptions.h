@@ -10,4 +10,14 @@ namespace exception {
 
     class vlog_path_error : std::exception {};
 
+    class vlog_io_error : std::exception {};
+
+    class wal_io_error : std::exception {};
+
+    class sstable_io_error : std::exception {};
+
+    class manifest_io_error : std::exception {};
+
+    class compression_error : std::exception {};
+
 }
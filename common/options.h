@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace def {
+
+    // the structures a memTable can store its entries in
+    enum class memtable_type {
+        skiplist,       // lock-free writers, always ordered
+        hash_table,     // O(1) writes to 16 shards, each locked by its writers
+        bplus_tree,     // writers take one lock, so they're serialized
+    };
+
+    // the filters of SSTables, whose values are stored in the flags of the header
+    enum class filter_type : uint32_t {
+        bloom = 0,          // the original one, which takes 4 bits from the whole filter
+        blocked_bloom = 1,  // all bits of a key are in one cache line
+        xor_filter = 2,     // static and about 15% smaller at the same false positive rate
+    };
+
+    // how a cached SSTable finds a key after its filter
+    enum class cached_table_layout {
+        blocks,     // the mapped blocks are searched like any other table
+        sorted,     // its keys are copied into one sorted array, apart from the payloads
+        eytzinger,  // the same, but the keys are in the order of a search from the root
+    };
+
+    // the codecs of the blocks of SSTables and of the values in vLog, which are written
+    // with each block or value, so they can be changed any time
+    enum class compression_type : uint8_t {
+        none = 0,
+        zlib = 1,   // only if the build finds zlib, or nothing is compressed
+    };
+
+    // when the write-ahead log forces its records onto the disk
+    enum class wal_sync_policy {
+        every_write,    // a write returns after its record is synced, shared by a group
+        interval,       // records are synced in the background every wal_sync_interval_ms
+        never,          // records are only handed to the OS, which survives process crashes
+    };
+
+    // options of KVStore which can be tuned upon construction
+    struct storeOptions {
+        // the bytes a memTable may take (keys, values and nodes) before it's flushed
+        size_t memtable_budget = 8 * 1024 * 1024;
+
+        // the structure of memTables, which suits the mix of operations best
+        memtable_type memtable_structure = memtable_type::skiplist;
+
+        // values shorter than this are stored in SSTables instead of vLog, 0 disables it
+        size_t inline_value_threshold = 64;
+
+        // the filter written into new SSTables, old ones keep theirs
+        filter_type sstable_filter = filter_type::blocked_bloom;
+
+        // the bits of filter for each key in the deepest level, and shallower levels,
+        // where most lookups are answered by the filter alone, get more (Monkey)
+        double filter_bits_per_key = 10;
+
+        // the bytes of data and inline values a SSTable is filled with before the next
+        // one is started, and the bytes of each of its blocks, which a lookup reads
+        size_t sstable_target_size = 2 * 1024 * 1024;
+        size_t sstable_block_size = 4 * 1024;
+
+        // keys and offsets in the blocks of new SSTables are bit-packed, which fits 2-4
+        // times more of them into a block
+        bool sstable_packed_blocks = true;
+
+        // the blocks of a SSTable and the files of a level are found with a piecewise
+        // linear model of their keys before a search of a few positions around
+        bool learned_index = true;
+
+        // the keys of the tables of cached levels are searched in memory, which takes
+        // 24 bytes for each of them on top of the mapped file
+        cached_table_layout cached_layout = cached_table_layout::eytzinger;
+
+        // the bits of range filter for each key, which lets scans skip SSTables without
+        // keys in the range, 0 disables it
+        double range_filter_bits_per_key = 8;
+
+        // the blocks of new SSTables in the levels from compression_start_level on are
+        // compressed, while the upper ones, which are read most, stay as they are, and
+        // a block or value is only compressed if it saves at least 1/8 of its bytes
+        compression_type sstable_compression = compression_type::none;
+        size_t compression_start_level = 2;
+        compression_type value_compression = compression_type::none;
+
+        // the durability of writes which haven't been flushed into SSTables
+        wal_sync_policy wal_sync = wal_sync_policy::interval;
+        size_t wal_sync_interval_ms = 10;
+    };
+
+}
@@ -0,0 +1,73 @@
+#include "compression.h"
+#include "../common/exceptions.h"
+
+#if defined(HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace compression {
+
+    // compressed data is only kept if it saves at least 1/8 of the bytes, or reading it
+    // back costs more than it saves
+    static bool worthKeeping(size_t raw_size, size_t compressed_size) {
+        return compressed_size < raw_size - raw_size / 8;
+    }
+
+#if defined(HAVE_ZLIB)
+    // the fastest level, since most of the saving of text-like values is there already
+    static const int zlib_level = Z_BEST_SPEED;
+#endif
+
+    bool available(compression_type type) {
+        switch (type) {
+        case compression_type::none:
+            return true;
+        case compression_type::zlib:
+#if defined(HAVE_ZLIB)
+            return true;
+#else
+            return false;
+#endif
+        }
+        return false;
+    }
+
+    bool compress(compression_type type, std::string_view src, std::string& dst) {
+        switch (type) {
+        case compression_type::zlib: {
+#if defined(HAVE_ZLIB)
+            uLongf length = compressBound(src.size());
+            dst.resize(length);
+            if (compress2((Bytef*)dst.data(), &length, (const Bytef*)src.data(), src.size(), 
+                zlib_level) != Z_OK) return false;
+            dst.resize(length);
+            return worthKeeping(src.size(), length);
+#else
+            return false;
+#endif
+        }
+        default:
+            return false;
+        }
+    }
+
+    void decompress(compression_type type, std::string_view src, std::string& dst, 
+        size_t raw_size) {
+        switch (type) {
+        case compression_type::none:
+            dst.assign(src);
+            return;
+        case compression_type::zlib: {
+#if defined(HAVE_ZLIB)
+            dst.resize(raw_size);
+            uLongf length = raw_size;
+            if (uncompress((Bytef*)dst.data(), &length, (const Bytef*)src.data(), 
+                src.size()) == Z_OK && length == raw_size) return;
+#endif
+            throw exception::compression_error();
+        }
+        }
+        throw exception::compression_error();
+    }
+
+}
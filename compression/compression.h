@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include "../common/options.h"
+
+namespace compression {
+
+    using def::compression_type;
+
+    // whether the codec is built in, which depends on the libraries found by the build,
+    // and none always is
+    bool available(compression_type type);
+
+    // compress src into dst, and return false if the codec isn't built in or saves too
+    // little, when src is best stored as it is
+    bool compress(compression_type type, std::string_view src, std::string& dst);
+
+    // ATTENTION! throws compression_error if the codec isn't built in or src is corrupted
+    void decompress(compression_type type, std::string_view src, std::string& dst, 
+        size_t raw_size);
+
+}
@@ -2,11 +2,15 @@
 #include "common/definitions.h"
 #include <algorithm>
 #include <cstddef>
+#include <functional>
 #include <iterator>
 #include <vector>
 
-KVStore::KVStore(const std::string &dir, const std::string &vlog) : KVStoreAPI(dir, vlog), 
-    directory(dir), v_log(vlog), mem_table(dir), level_manager(dir) {
+KVStore::KVStore(const std::string &dir, const std::string &vlog, 
+    const def::storeOptions &options) : KVStoreAPI(dir, vlog), directory(dir), options(options), 
+    v_log(vlog), level_manager(dir, options), 
+    wal_log(dir, options.wal_sync, options.wal_sync_interval_ms), 
+    mem_table(std::make_unique<memTable>(dir, options)) {
     // get the max timestamp for memTable to use
     size_t cur_level_number = level_manager.size();
     for (size_t i = 0; i < cur_level_number; ++i) {
@@ -21,37 +25,135 @@ KVStore::KVStore(const std::string &dir, const std::string &vlog) : KVStoreAPI(d
             }
 
             // set timestamp for memTable
-            mem_table.setTimestamp(max_timestamp + 1);
+            mem_table->setTimestamp(max_timestamp + 1);
             break;
         }
     }
+
+    // the writes lost from memory by the last run
+    recoverFromLogs();
+
+    // start flushing in the background
+    flush_thread = std::thread(&KVStore::backgroundFlush, this);
 }
 
 KVStore::~KVStore() {
     // write MemTable into file when the instance is destroyed
-    writeMemTableIntoFile();
+    {
+        std::unique_lock<std::shared_mutex> lock(mem_mutex);
+        if (!mem_table->empty()) {
+            waitForRoom(lock);
+            switchMemTable();
+        }
+        stop_flushing = true;
+    }
+
+    // the background thread drains all immutable tables before stopping
+    flush_cv.notify_one();
+    flush_thread.join();
+}
+
+void KVStore::backgroundFlush() {
+    while (true) {
+        // wait for the oldest immutable table
+        const memTable* table;
+        {
+            std::unique_lock<std::shared_mutex> lock(mem_mutex);
+            flush_cv.wait(lock, [this]() { return stop_flushing || !immutable_tables.empty(); });
+
+            // all tables have been flushed before stopping
+            if (immutable_tables.empty()) return;
+            table = immutable_tables.front().get();
+        }
+
+        // no writer touches the table any more, while readers may still read it
+        writeMemTableIntoFile(*table);
+
+        // the contents are in SSTables now, so readers needn't read the table
+        std::string log_name;
+        {
+            std::unique_lock<std::shared_mutex> lock(mem_mutex);
+            immutable_tables.pop_front();
+            log_name = std::move(immutable_logs.front());
+            immutable_logs.pop_front();
+        }
+        drained_cv.notify_all();
+
+        // nor is the log needed for recovery
+        utils::rmfile(log_name);
+    }
 }
 
-void KVStore::writeMemTableIntoFile() {
+void KVStore::writeMemTableIntoFile(const memTable& table) {
     // if empty, no need to write into file
-    if (mem_table.empty()) return;
+    if (table.empty()) return;
 
     // write vLog and memTable into disk
-    ssTableContent* content_to_write = mem_table.getContent(v_log);
-    // v_log must be flushed before table is written for multi-process
-    v_log.flush();		// flush into vlog file
+    std::vector<ssTableContent*> contents_to_write = table.getContent(v_log);
+    // v_log must be flushed before table is written for multi-process, and be on the disk
+    // before the log of the table is removed, unless the log isn't synced either
+    if (options.wal_sync != def::wal_sync_policy::never) v_log.sync();
+    else v_log.flush();
+
+    // write contents_to_write into file system with the format of SSTable, where only the
+    // background thread, or recovery before it starts, changes the levels, and level_mutex
+    // is taken exclusively just to swap the files readers see
+    for (ssTableContent* content_to_write : contents_to_write) {
+        level_manager.writeIntoSSTableFile(content_to_write, level_mutex);
+    }
+}
+
+void KVStore::recoverFromLogs() {
+    // write a table recovered from logs into files directly, before any reader comes
+    auto write_recovered_table = [this]() {
+        writeMemTableIntoFile(*mem_table);
+        uint64_t next_timestamp = mem_table->getTimestamp() + 1;
+        mem_table->clear();
+        mem_table->setTimestamp(next_timestamp);
+    };
+
+    // replay the logs from the oldest to the newest, so newer values win
+    for (const std::string& log_name : wal_log.recoveredLogs()) {
+        writeAheadLog::replay(log_name, [&](const key_type& key, const entry_view& entry) {
+            if (!mem_table->apply(key, entry)) write_recovered_table();
+        });
+    }
+    if (!mem_table->empty()) write_recovered_table();
+
+    // the recovered writes are all in SSTables now
+    for (const std::string& log_name : wal_log.recoveredLogs()) {
+        utils::rmfile(log_name);
+    }
+}
+
+void KVStore::switchMemTable() {
+    // the full table becomes immutable together with its log, and a fresh one accepts writes
+    uint64_t next_timestamp = mem_table->getTimestamp() + 1;
+    immutable_tables.push_back(std::move(mem_table));
+    immutable_logs.push_back(wal_log.rotate());
+    mem_table = std::make_unique<memTable>(directory, options);
+    mem_table->setTimestamp(next_timestamp);
 
-    // write content_to_write into file system with the format of SSTable
-    level_manager.writeIntoSSTableFile(content_to_write);
+    // wake up the background thread
+    flush_cv.notify_one();
+}
 
-    // update mem_table
-    mem_table.setTimestamp(mem_table.getTimestamp() + 1);
-    mem_table.clear();
+void KVStore::waitForRoom(std::unique_lock<std::shared_mutex>& lock) {
+    // stall writers when too many tables are waiting for flushing
+    drained_cv.wait(lock, [this]() { 
+        return immutable_tables.size() < def::max_immutable_number; 
+    });
 }
 
 void KVStore::flush() {
-    // directly flush all contents into disk
-    writeMemTableIntoFile();
+    std::unique_lock<std::shared_mutex> lock(mem_mutex);
+
+    // directly flush all contents into disk, and wait until it's done
+    if (!mem_table->empty()) {
+        waitForRoom(lock);
+        switchMemTable();
+    }
+    drained_cv.wait(lock, [this]() { return immutable_tables.empty(); });
 }
 
 /**
@@ -59,34 +161,106 @@ void KVStore::flush() {
  * No return values for simplicity.
  */
 void KVStore::put(key_type key, const value_type& value) {
-    // insert key-value pair into the mem_table
-    if (!mem_table.insert(key, value)) {
-        writeMemTableIntoFile();
+    writeEntry(key, entry_view{ def::entry_kind::value, value });
+}
+
+void KVStore::writeEntry(const key_type& key, const entry_view& entry) {
+    std::string record;
+    writeAheadLog::encode(record, key, entry);
+
+    // log and insert the entry into the mem_table together with other writers,
+    // who share the writes and syncs of the log, while those of the same key wait
+    bool full;
+    {
+        std::shared_lock<std::shared_mutex> lock(mem_mutex);
+        std::lock_guard<std::mutex> stripe_lock(
+            write_stripes[std::hash<key_type>()(key) % def::write_stripe_number]);
+        wal_log.append(record);
+        full = !mem_table->apply(key, entry);
+    }
+
+    // only one writer switches the table, the others may have done it in the meantime
+    if (full) {
+        std::unique_lock<std::shared_mutex> lock(mem_mutex);
+        waitForRoom(lock);
+        if (mem_table->full()) switchMemTable();
     }
 }
 
-std::optional<std::pair<uint64_t, u_int32_t>> KVStore::getPairFromSSTable(const key_type& key) {
+void KVStore::putWithoutLock(const key_type& key, const value_type& value, 
+    std::unique_lock<std::shared_mutex>& lock) {
+    // insert key-value pair into the mem_table, the values reinserted by gc needn't be
+    // logged since their old copies stay valid until they are flushed
+    if (!mem_table->insert(key, value)) {
+        waitForRoom(lock);
+        if (mem_table->full()) switchMemTable();
+    }
+}
+
+/**
+ * Apply all puts and deletes in the batch atomically.
+ * Readers see either none or all of them.
+ */
+void KVStore::write(const writeBatch& batch) {
+    if (batch.empty()) return;
+
+    // the stripes of all keys in the batch are taken in a fixed order, so batches
+    // sharing stripes can't wait for each other
+    std::vector<size_t> stripes;
+    batch.forEach([&stripes](const key_type& key, const entry_view&) {
+        stripes.push_back(std::hash<key_type>()(key) % def::write_stripe_number);
+    });
+    std::sort(stripes.begin(), stripes.end());
+    stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+
+    // the batch is logged together with other writers like a single write, and the
+    // readers of mem_table are only excluded while it's applied
+    bool full;
+    {
+        std::shared_lock<std::shared_mutex> lock(mem_mutex);
+        std::vector<std::unique_lock<std::mutex>> stripe_locks;
+        for (size_t stripe : stripes) stripe_locks.emplace_back(write_stripes[stripe]);
+
+        // the batch is one record in the log, so it's recovered all or nothing
+        wal_log.append(batch.getPayload());
+
+        // the table may grow past its budget in the middle, which getContent can handle
+        {
+            std::unique_lock<std::shared_mutex> batch_lock(batch_mutex);
+            batch.forEach([this](const key_type& key, const entry_view& entry) {
+                mem_table->apply(key, entry);
+            });
+        }
+        full = mem_table->full();
+    }
+
+    // only one writer switches the table, the others may have done it in the meantime
+    if (full) {
+        std::unique_lock<std::shared_mutex> lock(mem_mutex);
+        waitForRoom(lock);
+        if (mem_table->full()) switchMemTable();
+    }
+}
+
+std::optional<ssTableEntry> KVStore::getEntryFromSSTable(const key_type& key) {
     // iterate through all levels from zero to level_manager.size() - 1
     for (size_t level = 0; level < level_manager.size(); ++level) {
-        // start scaning
-        level_files files = level_manager.getLevelFiles(level);
+        // start scaning, and the files don't change while level_mutex is held
+        const level_files& files = level_manager.getLevelFiles(level);
         if (files.empty()) continue;
 
         // iterate through all files in each level
         if (level) [[likely]] {
             // if the level number is larger than 0, all files is ordered and unique
-            // use binary_search to find the first file detail whose max_key is larger than key
-            auto file_detail_less = [](const managerFileDetail& file, const key_type& key) -> bool {
-                return file.header.max_key < key;
-            };
-            auto it = std::lower_bound(files.begin(), files.end(), key, file_detail_less);
+            // find the first file detail whose max_key is larger than key
+            auto it = files.begin() + level_manager.findFile(level, key);
 
             // if not found
             if (it == files.end()) continue;
 
             // there's only one situation, so try to find it in the file
             // search for the key in SSTable
-            std::optional<std::pair<uint64_t, uint32_t>> result;
+            std::optional<ssTableEntry> result;
             if (it->table_cache) {
                 // get in cache
                 result = it->table_cache->get(key);
@@ -99,13 +273,13 @@ std::optional<std::pair<uint64_t, u_int32_t>> KVStore::getPairFromSSTable(const
 
             // if the key is found
             if (result.has_value()) {
-                return result.value();
+                return result;
             }
         }
         else {
             for (const managerFileDetail& file : files) {
                 // search for the key in SSTable
-                std::optional<std::pair<uint64_t, uint32_t>> result;
+                std::optional<ssTableEntry> result;
                 if (file.table_cache) {
                     // get in cache
                     result = file.table_cache->get(key);
@@ -118,7 +292,7 @@ std::optional<std::pair<uint64_t, u_int32_t>> KVStore::getPairFromSSTable(const
 
                 // if the key is found
                 if (result.has_value()) {
-                    return result.value();
+                    return result;
                 }
             }
         }
@@ -128,20 +302,30 @@ std::optional<std::pair<uint64_t, u_int32_t>> KVStore::getPairFromSSTable(const
     return std::nullopt;
 }
 
-std::optional<value_type> KVStore::getFromMemTable(const key_type& key) const {
-    return mem_table.get(key);
+std::optional<entry_type> KVStore::getFromMemTable(const key_type& key) const {
+    // the newer table, the earlier it is searched
+    auto result = mem_table->get(key);
+    auto it = immutable_tables.rbegin(), eit = immutable_tables.rend();
+    for (; !result.has_value() && it != eit; ++it) {
+        result = (*it)->get(key);
+    }
+
+    return result;
 }
 
 std::optional<value_type> KVStore::getFromSSTable(const key_type& key) {
-    auto pair_result = getPairFromSSTable(key);
+    auto entry_result = getEntryFromSSTable(key);
 
     // if found
-    if (pair_result.has_value()) {
-        // if pair_result represents a deleted pair
-        if (!pair_result->second) return std::nullopt;
+    if (entry_result.has_value()) {
+        const ssTableData& data = entry_result->data;
+
+        // if entry_result represents a deleted pair
+        if (def::isTombstone(data)) return std::nullopt;
 
-        // get the value from vlog file
-        return v_log.get(pair_result->first, pair_result->second).second;
+        // the value is in the SSTable, or get it from vlog file
+        if (def::isInlineValue(data)) return std::move(entry_result->value);
+        return v_log.get(data.offset, data.value_length).second;
     }
 
     // not found
@@ -149,12 +333,16 @@ std::optional<value_type> KVStore::getFromSSTable(const key_type& key) {
 }
 
 void KVStore::scanFromMemTable(const key_type& key1, const key_type& key2, 
-    std::map<key_type, value_type>& map) const {
-    mem_table.scan(key1, key2, map);
+    std::map<key_type, entry_type>& map) const {
+    // newer values are inserted first, so they won't be replaced
+    mem_table->scan(key1, key2, map);
+    for (auto it = immutable_tables.rbegin(); it != immutable_tables.rend(); ++it) {
+        (*it)->scan(key1, key2, map);
+    }
 }
 
 void KVStore::scanFromSSTable(const key_type& key1, const key_type& key2, 
-    std::map<key_type, value_type>& map) {
+    std::map<key_type, entry_type>& map) {
     // iterate through all levels from zero to level_manager.size() - 1
     for (size_t level = 0; level < level_manager.size(); ++level) {
         // path to scan files
@@ -166,23 +354,19 @@ void KVStore::scanFromSSTable(const key_type& key1, const key_type& key2,
             return;
         }
 
-        // start scaning
-        level_files files = level_manager.getLevelFiles(level);
+        // start scaning, and the files don't change while level_mutex is held
+        const level_files& files = level_manager.getLevelFiles(level);
         if (files.empty()) continue;
 
-        // this vector is used to store all ssTableData in current level
-        std::vector<ssTableData> vec;
+        // this vector is used to store all ssTableEntry in current level
+        std::vector<ssTableEntry> vec;
         level_files files_to_scan;
 
         // iterate through all files in each level
         if (level) [[likely]] {
             // if the level number is larger than 0, all files is ordered and unique
-            // use binary_search to find the first file detail whose max_key is larger than key1
-            auto file_detail_less = [](const managerFileDetail& file, const key_type& key) -> bool {
-                return file.header.max_key < key;
-            };
-            auto it_begin = std::lower_bound(files.begin(), files.end(), 
-                key1, file_detail_less);
+            // find the first file detail whose max_key is larger than key1
+            auto it_begin = files.begin() + level_manager.findFile(level, key1);
             auto eit = files.end(), it_end = it_begin;
 
             // if not found
@@ -198,8 +382,8 @@ void KVStore::scanFromSSTable(const key_type& key1, const key_type& key2,
             files_to_scan = files;
         }
 
-        // iterate through all files in level 0
-        for (const managerFileDetail& file : files) {
+        // iterate through all files overlapping the range
+        for (const managerFileDetail& file : files_to_scan) {
             // search for the key in SSTable
             SSTable* table;
             bool from_cache = false;
@@ -215,7 +399,7 @@ void KVStore::scanFromSSTable(const key_type& key1, const key_type& key2,
             }
 
             // scan for results
-            std::vector<ssTableData> temp_vec = table->scan(key1, key2);
+            std::vector<ssTableEntry> temp_vec = table->scan(key1, key2);
             // here use move function to reduce cost
             vec.insert(vec.end(), std::make_move_iterator(temp_vec.begin()), 
                 std::make_move_iterator(temp_vec.end()));
@@ -225,17 +409,24 @@ void KVStore::scanFromSSTable(const key_type& key1, const key_type& key2,
         }
 
         // insert ssTableData into the map
-        for (const ssTableData& data : vec) {
+        for (ssTableEntry& entry : vec) {
+            const ssTableData& data = entry.data;
+
             // check whether the key appeared in the map or not
             if (map.find(data.key) == map.end()) {
                 // if the pair represents a deleted pair
-                if (!data.value_length) {
-                    map[data.key] = def::delete_tag;
+                if (def::isTombstone(data)) {
+                    map[data.key] = entry_type{ def::entry_kind::tombstone, value_type() };
+                }
+                // the value is already read from the SSTable
+                else if (def::isInlineValue(data)) {
+                    map[data.key] = entry_type{ def::entry_kind::value, std::move(entry.value) };
                 }
                 else {
                     // get value from vlog file and then put it into a skiplist
                     auto result_pair = v_log.get(data.offset, data.value_length);
-                    map[result_pair.first] = result_pair.second;
+                    map[result_pair.first] = 
+                        entry_type{ def::entry_kind::value, std::move(result_pair.second) };
                 }
             }
         }
@@ -247,19 +438,22 @@ void KVStore::scanFromSSTable(const key_type& key1, const key_type& key2,
  * An empty string indicates not found.
  */
 value_type KVStore::get(key_type key) {
-    // find from memory
-    auto result_mem = getFromMemTable(key);
-    if (result_mem.has_value()) {
-        // already deleted
-        if (result_mem.value() == def::delete_tag) return value_type();
-        return result_mem.value();
+    // find from memory, the tables themselves are read without locks
+    {
+        std::shared_lock<std::shared_mutex> lock(mem_mutex);
+        std::shared_lock<std::shared_mutex> batch_lock(batch_mutex);
+        auto result_mem = getFromMemTable(key);
+        if (result_mem.has_value()) {
+            // already deleted
+            if (result_mem->isTombstone()) return value_type();
+            return std::move(result_mem->value);
+        }
     }
 
-    // find from storage
+    // find from storage, values always reach SSTables before leaving memory
+    std::shared_lock<std::shared_mutex> lock(level_mutex);
     auto result_sto = getFromSSTable(key);
     if (result_sto.has_value()) {
-        // already deleted
-        if (result_sto.value() == def::delete_tag) return value_type();
         return result_sto.value();
     }
 
@@ -275,8 +469,8 @@ bool KVStore::del(key_type key) {
     // not found
     if (get(key) == value_type()) return false;
 
-    // insert a delete pair
-    put(key, def::delete_tag);
+    // insert a tombstone
+    writeEntry(key, entry_view{ def::entry_kind::tombstone, def::value_view() });
     return true;
 }
 
@@ -285,11 +479,18 @@ bool KVStore::del(key_type key) {
  * including memtable and all sstables files.
  */
 void KVStore::reset() {
-    // clear mem_table
-    mem_table.clear();
-    mem_table.setTimestamp(0);
+    std::unique_lock<std::shared_mutex> lock(mem_mutex);
+
+    // wait until the background thread has nothing to do
+    drained_cv.wait(lock, [this]() { return immutable_tables.empty(); });
+
+    // clear mem_table and its log
+    mem_table->clear();
+    mem_table->setTimestamp(0);
+    wal_log.clear();
 
     // delete sstable files
+    std::unique_lock<std::shared_mutex> level_lock(level_mutex);
     level_manager.clear();
 
     // clear the vlog file
@@ -311,21 +512,28 @@ void KVStore::scan(key_type key1, key_type key2, std::list<std::pair<key_type, v
     }
 
     // use skipList to store all values found
-    std::map<key_type, value_type> map;
+    std::map<key_type, entry_type> map;
 
-    // scan from memory
-    scanFromMemTable(key1, key2, map);
+    // scan from memory, the tables themselves are read without locks
+    {
+        std::shared_lock<std::shared_mutex> lock(mem_mutex);
+        std::shared_lock<std::shared_mutex> batch_lock(batch_mutex);
+        scanFromMemTable(key1, key2, map);
+    }
 
-    // scan from storage
-    scanFromSSTable(key1, key2, map);
+    // scan from storage, the lock only excludes flushing and compaction
+    {
+        std::shared_lock<std::shared_mutex> lock(level_mutex);
+        scanFromSSTable(key1, key2, map);
+    }
 
     // append all contents in the skiplist to the list
     auto it = map.cbegin(), eit = map.cend();
     while (it != eit) {
         // if the pair isn't a deleted one
-        if (it->second != def::delete_tag) {
+        if (!it->second.isTombstone()) {
             // add to the list
-            list.push_back(*it);
+            list.emplace_back(it->first, std::move(it->second.value));
         }
 
         // iterate for the next
@@ -338,23 +546,35 @@ void KVStore::scan(key_type key1, key_type key2, std::list<std::pair<key_type, v
  * chunk_size is the size in byte you should AT LEAST recycle.
  */
 void KVStore::gc(uint64_t chunk_size) {
-    // check collected vLog entries here
-    std::vector<garbage_unit> garbage_to_validate = v_log.getGCReinsertion(chunk_size);
-
-    for (const garbage_unit& garbage : garbage_to_validate) {
-        def::vLogEntry entry = garbage.first;
-
-        // not in mem_table
-        if (!getFromMemTable(entry.key).has_value()) {
-            auto pair_result = getPairFromSSTable(entry.key);
-            if (pair_result.has_value() && pair_result->first == garbage.second) {
-                put(entry.key, entry.value);
+    {
+        // other writers are excluded while valid values are reinserted
+        std::unique_lock<std::shared_mutex> lock(mem_mutex);
+
+        // check collected vLog entries here
+        std::vector<garbage_unit> garbage_to_validate = v_log.getGCReinsertion(chunk_size);
+
+        for (const garbage_unit& garbage : garbage_to_validate) {
+            def::vLogEntry entry = garbage.first;
+
+            // not in mem_table
+            if (!getFromMemTable(entry.key).has_value()) {
+                std::shared_lock<std::shared_mutex> level_lock(level_mutex);
+                auto entry_result = getEntryFromSSTable(entry.key);
+                level_lock.unlock();
+
+                // the newest value of the key is still this one in vLog
+                if (entry_result.has_value() && !def::isInlineValue(entry_result->data) && 
+                    entry_result->data.offset == garbage.second) {
+                    putWithoutLock(entry.key, entry.value, lock);
+                }
             }
         }
     }
 
     // flush before collecting garbage for multi-process
     flush();
+
+    // no reader may use the offsets being collected
+    std::unique_lock<std::shared_mutex> level_lock(level_mutex);
     v_log.garbageCollection();
 }
-
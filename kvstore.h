@@ -2,20 +2,34 @@
 
 #include "kvstore_api.h"
 #include "common/definitions.h"
+#include "common/options.h"
 #include "memTable/memTable.h"
 #include "ssTable/ssTable.h"
 #include "vLog/vLog.h"
 #include "levelManager/levelManager.h"
+#include "wal/wal.h"
+#include "wal/writeBatch.h"
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <shared_mutex>
+#include <thread>
 
 using memtable::memTable;
 using sstable::SSTable;
 using vlog::vLog;
 using vlog::garbage_unit;
 using levelmanager::levelManager;
+using wal::writeAheadLog;
+using wal::writeBatch;
 using def::key_type;
 using def::value_type;
+using def::entry_type;
+using def::entry_view;
 using def::ssTableContent;
 using def::ssTableData;
+using def::ssTableEntry;
 using def::level_files;
 using def::managerFileDetail;
 
@@ -23,27 +37,68 @@ class KVStore : public KVStoreAPI
 {
 private:
     std::string directory;
+    def::storeOptions options;
 
     vLog v_log;
-    memTable mem_table;
     levelManager level_manager;
 
-    void writeMemTableIntoFile();
+    // every write is logged before it reaches mem_table
+    writeAheadLog wal_log;
+
+    // the memTable accepting writes, and the full ones waiting for flushing from the
+    // oldest to the newest, which are only read until the background thread flushes them
+    std::unique_ptr<memTable> mem_table;
+    std::deque<std::unique_ptr<memTable>> immutable_tables;
+
+    // the sealed logs of immutable_tables in the same order
+    std::deque<std::string> immutable_logs;
+
+    // writers share mem_mutex to insert into mem_table concurrently, while switching
+    // mem_table takes it exclusively, and readers share level_mutex to read level_manager,
+    // while flushing and compaction take it exclusively only to change the files
+    std::shared_mutex mem_mutex, level_mutex;
+
+    // the writers of a key hold its stripe from logging to applying, so the entries of
+    // the key reach mem_table in the order of the log, which is what recovery replays
+    std::array<std::mutex, def::write_stripe_number> write_stripes;
+
+    // a batch is logged like other writes, and only applied to mem_table holding this
+    // exclusively, so readers of mem_table sharing it see all of the batch or none
+    std::shared_mutex batch_mutex;
+
+    // the background thread flushing immutable_tables and the conditions it works with
+    std::thread flush_thread;
+    std::condition_variable_any flush_cv, drained_cv;
+    bool stop_flushing = false;
+
+    void backgroundFlush();
+    void writeMemTableIntoFile(const memTable& table);
     void flush();
+    void recoverFromLogs();
+
+    // ATTENTION! the caller must hold mem_mutex exclusively
+    void switchMemTable();
+    void waitForRoom(std::unique_lock<std::shared_mutex>& lock);
+    void putWithoutLock(const key_type& key, const value_type& value, 
+        std::unique_lock<std::shared_mutex>& lock);
+
+    // log and insert a value or a tombstone
+    void writeEntry(const key_type& key, const entry_view& entry);
 
     // get functions
-    std::optional<std::pair<uint64_t, u_int32_t>> getPairFromSSTable(const key_type& key);
-    std::optional<value_type> getFromMemTable(const key_type& key) const;
+    std::optional<ssTableEntry> getEntryFromSSTable(const key_type& key);
+    std::optional<entry_type> getFromMemTable(const key_type& key) const;
     std::optional<value_type> getFromSSTable(const key_type& key);
 
     // scan functions
     void scanFromMemTable(const key_type& key1, const key_type& key2, 
-        std::map<key_type, value_type>& map) const;
+        std::map<key_type, entry_type>& map) const;
     void scanFromSSTable(const key_type& key1, const key_type& key2, 
-        std::map<key_type, value_type>& map);
+        std::map<key_type, entry_type>& map);
 
 public:
-    KVStore(const std::string &dir, const std::string &vlog);
+    KVStore(const std::string &dir, const std::string &vlog, 
+        const def::storeOptions &options = def::storeOptions());
 
     ~KVStore();
 
@@ -53,6 +108,8 @@ public:
 
     bool del(key_type key) override;
 
+    void write(const writeBatch& batch);
+
     void reset() override;
 
     void scan(key_type key1, key_type key2, std::list<std::pair<key_type, value_type>>& list) override;
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace learnedindex {
+
+    // a line predicting the positions of the keys from first_key to the next segment
+    template <typename T>
+    struct linearSegment {
+        T first_key;
+        double slope, intercept;
+    };
+
+    // a piecewise linear model of where each of a sorted array of distinct keys is, whose
+    // prediction is at most error positions away, so a lookup searches a window of
+    // 2 * error + 1 instead of the whole array
+    //
+    // the keys are read with key_at(i), so the model is built over any sorted field, and
+    // its segments are either its own or read from somewhere else, like a mapped file
+    template <typename T>
+    class learnedIndex
+    {
+    private:
+        size_t error;
+        std::vector<linearSegment<T>> owned_segments;
+        const linearSegment<T>* segments = nullptr;
+        size_t segment_number = 0;
+
+        // a copy uses its own segments if it has them
+        const linearSegment<T>* firstSegment() const {
+            return owned_segments.empty() ? segments : owned_segments.data();
+        }
+
+    public:
+        explicit learnedIndex(size_t error = 8) : error(error) {}
+
+        // greedy shrinking cone: a segment takes keys while one slope still keeps all of
+        // them within error, and the middle of the allowed slopes is kept
+        template <typename KeyAt>
+        void build(KeyAt key_at, size_t n);
+
+        // ATTENTION! the segments must live as long as the index
+        void set(const linearSegment<T>* src, size_t number);
+
+        // the first position in [0, n) whose key isn't less than the key, which is the
+        // same as std::lower_bound even if the model doesn't fit the keys at all
+        template <typename KeyAt>
+        size_t lowerBound(KeyAt key_at, size_t n, const T& key) const;
+
+        bool empty() const { return !segment_number; }
+        size_t size() const { return segment_number; }
+        const linearSegment<T>* getSegments() const { return firstSegment(); }
+    };
+
+}
+
+// below is the implementation of learnedIndex
+namespace learnedindex {
+
+    template <typename T>
+    template <typename KeyAt>
+    void learnedIndex<T>::build(KeyAt key_at, size_t n) {
+        owned_segments.clear();
+        size_t start = 0;
+        double low_slope = 0, high_slope = INFINITY;
+        for (size_t i = 1; i <= n; ++i) {
+            if (i < n) {
+                double dx = static_cast<double>(key_at(i) - key_at(start));
+                double dy = static_cast<double>(i - start);
+                double point_low = (dy - error) / dx, point_high = (dy + error) / dx;
+                if (point_low <= high_slope && point_high >= low_slope) {
+                    low_slope = std::max(low_slope, point_low);
+                    high_slope = std::min(high_slope, point_high);
+                    continue;
+                }
+            }
+
+            // the cone is empty with the key, so the segment ends before it
+            double slope = std::isinf(high_slope) ? 0 : (low_slope + high_slope) / 2;
+            owned_segments.push_back({ key_at(start), slope, static_cast<double>(start) });
+            start = i;
+            low_slope = 0;
+            high_slope = INFINITY;
+        }
+        segments = nullptr;
+        segment_number = owned_segments.size();
+    }
+
+    template <typename T>
+    void learnedIndex<T>::set(const linearSegment<T>* src, size_t number) {
+        owned_segments.clear();
+        segments = src;
+        segment_number = number;
+    }
+
+    template <typename T>
+    template <typename KeyAt>
+    size_t learnedIndex<T>::lowerBound(KeyAt key_at, size_t n, const T& key) const {
+        // the whole array is searched without a model
+        size_t low = 0, high = n;
+        if (segment_number && n) {
+            // the last segment starting at or before the key, whose line predicts it
+            const linearSegment<T>* first = firstSegment();
+            const linearSegment<T>* it = std::upper_bound(first, first + segment_number,
+                key, [](const T& key, const linearSegment<T>& segment) -> bool
+                { return key < segment.first_key; });
+            if (it != first) {
+                --it;
+                double predicted = it->intercept + it->slope * static_cast<double>(key - it->first_key);
+                predicted = std::clamp(predicted, 0.0, static_cast<double>(n - 1));
+                size_t position = static_cast<size_t>(predicted);
+                low = position > error ? position - error : 0;
+                high = std::min(n, position + error + 2);
+            }
+            else {
+                high = 0;
+            }
+
+            // the window is widened to the whole side if the answer is beyond it
+            if (low && key_at(low - 1) >= key) low = 0;
+            if (high < n && key_at(high) < key) high = n;
+        }
+
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (key_at(mid) < key) low = mid + 1;
+            else high = mid;
+        }
+        return low;
+    }
+
+}
@@ -1,13 +1,63 @@
 #include "levelManager.h"
+#include "../common/exceptions.h"
 #include "../utils.h"
 #include <algorithm>
+#include <cmath>
+#include <atomic>
 #include <cstddef>
+#include <exception>
+#include <map>
+#include <mutex>
 #include <queue>
 #include <sys/time.h>
+#include <thread>
 
 namespace levelmanager {
 
-    levelManager::levelManager(const std::string& dir) : directory_name(dir) {
+    // call task(i) for each i in [0, n) by a pool of threads, and rethrow the first
+    // exception any of them throws after all of them stop
+    template <typename Task>
+    static void parallelFor(size_t n, Task task) {
+        size_t thread_number = std::min<size_t>(n, std::max(1u, std::thread::hardware_concurrency()));
+        std::atomic<size_t> next{ 0 };
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto worker = [&]() {
+            for (size_t i = next++; i < n; i = next++) {
+                try {
+                    task(i);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error) error = std::current_exception();
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < thread_number; ++i) threads.emplace_back(worker);
+        worker();
+        for (std::thread& thread : threads) thread.join();
+        if (error) std::rethrow_exception(error);
+    }
+
+    // the manifest names a file without its directory, which is that of its level
+    static std::string baseName(const std::string& file_name) {
+        return std::filesystem::path(file_name).filename().string();
+    }
+
+    levelManager::levelManager(const std::string& dir, const def::storeOptions& options) : 
+        directory_name(dir), sstable_filter(options.sstable_filter), 
+        filter_bits_per_key(options.filter_bits_per_key), 
+        range_filter_bits_per_key(options.range_filter_bits_per_key), 
+        sstable_target_size(options.sstable_target_size), 
+        sstable_block_size(options.sstable_block_size), 
+        sstable_packed_blocks(options.sstable_packed_blocks), 
+        sstable_compression(options.sstable_compression), 
+        compression_start_level(options.compression_start_level), 
+        learned_index(options.learned_index), cached_layout(options.cached_layout), 
+        sync_files(options.wal_sync != def::wal_sync_policy::never), 
+        manifest_log(dir, sync_files) {
         // update file_prefix for levelManager
         updatePrefix();
 
@@ -25,30 +75,14 @@ namespace levelmanager {
         }
     }
 
-    level_files levelManager::sortFiles(const std::vector<std::string>& files, size_t level) const {
-        // use a vector to store all file details
-        level_files current_level;
-
-        // scan all files in this level
-        for (std::string file : files) {
-            // use a safer way to get directory
-            std::filesystem::path path(directory_name);
-            path.append(def::sstable_base_directory_name + std::to_string(level));
-            path.append(file);
-
-            // open SSTable and create managerFileDetail for it
-            SSTable* table = new SSTable(path.string());
-            managerFileDetail detail { path.string(), table->tableContent()->header };
-
-            // store SSTable into cache or delete it
-            if (level < def::cached_levels) {
-                detail.table_cache = table;
-            }
-            else {
-                delete table;
+    void levelManager::sortFiles(level_files& current_level, size_t level) const {
+        // the tables of cached levels are opened by the first lookups reaching them
+        if (level < def::cached_levels) {
+            for (managerFileDetail& detail : current_level) {
+                detail.table_cache = new SSTable(detail.file_name, detail.header);
+                detail.table_cache->cacheKeys(cached_layout, 
+                    def::maxCachedKeyNumber(sstable_target_size));
             }
-
-            current_level.push_back(detail);
         }
 
         // sort with details read above
@@ -61,8 +95,6 @@ namespace levelmanager {
             std::sort(current_level.begin(), current_level.end(), 
                 def::compare_file_detail_zero_level);
         }
-
-        return current_level;
     }
 
     void levelManager::scanLevels() {
@@ -70,24 +102,80 @@ namespace levelmanager {
         level_number = 0;
         levels.clear();
 
-        // use a safer way to process path
-        std::filesystem::path path(directory_name);
-        path.append(def::sstable_base_directory_name + std::to_string(level_number));
+        // the levels are the directories from level 0 to the first missing one
+        std::vector<std::string> level_paths;
+        while (utils::dirExists(def::getLevelDirectoryPath(directory_name, level_number))) {
+            level_paths.push_back(def::getLevelDirectoryPath(directory_name, level_number++));
+        }
 
-        // start to scan
-        while (utils::dirExists(path.string())) {
-            // scan all files in the current level
-            std::vector<std::string> current_level;
-            utils::scanDir(path.string(), current_level);
+        // the levels are listed at the same time
+        std::vector<std::vector<std::string>> file_names(level_number);
+        parallelFor(level_number, [&](size_t level) {
+            utils::scanDir(level_paths[level], file_names[level]);
+        });
+
+        if (manifest_log.exists()) {
+            // the files of each level are those the edits leave there
+            std::vector<std::map<std::string, def::ssTableHeader>> level_headers(level_number);
+            manifest_log.replay([&](manifest::edit_kind kind, size_t level, 
+                const std::string& name, const def::ssTableHeader& header) {
+                if (level >= level_headers.size()) level_headers.resize(level + 1);
+                if (kind == manifest::edit_kind::add_file) level_headers[level][name] = header;
+                else level_headers[level].erase(name);
+            });
+            while (level_number < level_headers.size()) {
+                level_paths.push_back(def::getLevelDirectoryPath(directory_name, level_number));
+                utils::mkdir(level_paths[level_number++]);
+                file_names.emplace_back();
+            }
 
-            // push into vector
-            levels.push_back(sortFiles(current_level, level_number));
-            levels_time.push_back(0);
+            levels.resize(level_number);
+            for (size_t level = 0; level < level_number; ++level) {
+                for (const auto& [name, header] : level_headers[level]) {
+                    // use a safer way to get directory
+                    std::filesystem::path path(level_paths[level]);
+                    path.append(name);
+                    levels[level].push_back(managerFileDetail{ path.string(), header });
+                }
 
-            // next iteration
-            path = path.parent_path().append(def::sstable_base_directory_name + 
-                std::to_string(++level_number));
+                // the others are written by a flush or compaction that crashed before its
+                // edit, or left by one after it
+                for (const std::string& file : file_names[level]) {
+                    if (!level_headers[level].count(file)) {
+                        std::filesystem::path path(level_paths[level]);
+                        path.append(file);
+                        utils::rmfile(path.string());
+                    }
+                }
+            }
+        }
+        else {
+            // a store written before the manifest has the headers of all files read at the
+            // same time, which is all of a file read at startup
+            std::vector<managerFileDetail*> details;
+            levels.resize(level_number);
+            for (size_t level = 0; level < level_number; ++level) {
+                for (const std::string& file : file_names[level]) {
+                    // use a safer way to get directory
+                    std::filesystem::path path(level_paths[level]);
+                    path.append(file);
+                    levels[level].push_back(managerFileDetail{ path.string() });
+                }
+                for (managerFileDetail& detail : levels[level]) details.push_back(&detail);
+            }
+            parallelFor(details.size(), [&](size_t i) {
+                details[i]->header = sstable::readHeader(details[i]->file_name);
+            });
         }
+
+        levels_time.assign(level_number, 0);
+        for (size_t level = 0; level < level_number; ++level) {
+            sortFiles(levels[level], level);
+        }
+        buildLevelModels();
+
+        // the manifest starts over from the files found
+        rewriteManifest();
     }
 
     const level_files& levelManager::getLevelFiles(size_t level) const {
@@ -97,11 +185,57 @@ namespace levelmanager {
         return levels[level];
     }
 
+    size_t levelManager::findFile(size_t level, const key_type& key) const {
+        // the value of level must be less than level_number
+        assert(level && level < level_number);
+
+        const level_files& files = levels[level];
+        auto max_key_at = [&files](size_t i) { return files[i].header.max_key; };
+        return level_models[level].lowerBound(max_key_at, files.size(), key);
+    }
+
+    sstable::learnedIndex levelManager::buildLevelModel(const level_files& files, 
+        size_t level) const {
+        // the files of level 0 overlap, so they're never searched by keys
+        sstable::learnedIndex model(def::learned_index_error);
+        if (!learned_index || !level) return model;
+        model.build([&files](size_t i) { return files[i].header.max_key; }, files.size());
+        return model;
+    }
+
+    void levelManager::buildLevelModels() {
+        level_models.clear();
+        for (size_t level = 0; level < level_number; ++level) {
+            level_models.push_back(buildLevelModel(levels[level], level));
+        }
+    }
+
+    void levelManager::rewriteManifest() {
+        manifest::versionEdit snapshot;
+        for (size_t level = 0; level < level_number; ++level) {
+            for (const managerFileDetail& file_detail : levels[level]) {
+                snapshot.addFile(level, baseName(file_detail.file_name), file_detail.header);
+            }
+        }
+        manifest_log.rewrite(snapshot);
+    }
+
+    void levelManager::syncLevel(size_t level) const {
+        // the tables themselves are synced once they're written
+        if (sync_files && utils::syncDir(def::getLevelDirectoryPath(directory_name, level)) != 0) {
+            throw exception::sstable_io_error();
+        }
+    }
+
     size_t levelManager::size() const {
         return level_number;
     }
 
     void levelManager::clear() {
+        // the manifest forgets the files first, so a crash in the middle leaves files that
+        // are removed by the next startup
+        manifest_log.rewrite(manifest::versionEdit());
+
         // remove files from each level
         for (const level_files& current_level : levels) {
             for (const managerFileDetail& file_detail : current_level) {
@@ -125,6 +259,7 @@ namespace levelmanager {
         level_number = 0;
         levels.clear();
         levels_time.clear();
+        level_models.clear();
     }
 
     std::vector<ssTableContent*> levelManager::mergeSSTable(
@@ -132,7 +267,7 @@ namespace levelmanager {
         // some definitions
         std::vector<ssTableContent*> merged_contents;
         std::vector<SSTable*> contents;
-        std::vector<size_t> index;
+        std::vector<sstable::ssTableCursor> cursors;
         size_t file_number = files.size();
 
         // use std::greater to build a less-root heap
@@ -150,29 +285,28 @@ namespace levelmanager {
                 table = new SSTable(files[i].file_name);
             }
 
+            // the whole table is read in order
+            table->adviseSequential();
+
             // push the first data element into pq
             contents.push_back(table);
-            pq.push(std::make_pair(table->tableContent()->data[0], i));
-            index.push_back(1);
+            cursors.emplace_back(table);
+            pq.push(std::make_pair(cursors.back().data(), i));
 
             // get the time
-            max_time = std::max(max_time, table->tableContent()->header.time);
+            max_time = std::max(max_time, table->tableHeader().time);
         }
 
         // some variables used in later merging
         ssTableContent* current_content = new ssTableContent;
-        bloomFilter filter(def::bloom_filter_size);
-        size_t index_in_content_data = 0;
         key_type current_key{};
         bool initialized = false;
 
         // a lambda function to set data and then push current_content into the vector
         auto collect_data_for_content = [&]() {
-            memcpy(&current_content->bloomFilterContent, filter.getContent(), 
-                def::bloom_filter_size);
-            current_content->header.key_value_pair_number = index_in_content_data;
-            current_content->header.min_key = current_content->data[0].key;
-            current_content->header.max_key = current_content->data[index_in_content_data - 1].key;
+            current_content->header.key_value_pair_number = current_content->data.size();
+            current_content->header.min_key = current_content->data.front().key;
+            current_content->header.max_key = current_content->data.back().key;
             current_content->header.time = max_time;
             merged_contents.push_back(current_content);
         };
@@ -185,55 +319,56 @@ namespace levelmanager {
 
             // some variables used later
             size_t table_index = front_element.second;
-            auto content_of_current_table = contents[table_index]->tableContent();
-
-            if (index[table_index] < content_of_current_table->header.key_value_pair_number) [[likely]] {
-                // push the next element into priority_queue
-                pq.push(std::make_pair(content_of_current_table->data[index[table_index]], table_index));
-                ++index[table_index];
-            }
-
-            // if same keys encountered
-            if (initialized && current_key == front_element.first.key) [[unlikely]] continue;
+            sstable::ssTableCursor& cursor = cursors[table_index];
 
-            // insert into these structures
-            if (front_element.first.value_length || !remove_deleted_pair) [[likely]] {
+            // insert into these structures unless same keys encountered, and the inline
+            // value is read before the cursor leaves its block
+            if ((!initialized || current_key != front_element.first.key) && 
+                (!def::isTombstone(front_element.first) || !remove_deleted_pair)) [[likely]] {
                 // if the pair is a deleted one and remove_deleted_pair is specified
-                current_content->data[index_in_content_data++] = front_element.first;
-                filter.insert(front_element.first.key);
+                ssTableData& data = current_content->data.emplace_back(front_element.first);
+
+                // inline values move into the merged table
+                if (def::isInlineValue(data)) {
+                    data.offset = current_content->appendInlineValue(cursor.inlineValue());
+                }
             }
             current_key = front_element.first.key;
             initialized = true;
 
+            // push the next element into priority_queue
+            cursor.next();
+            if (cursor.valid()) [[likely]] {
+                pq.push(std::make_pair(cursor.data(), table_index));
+            }
+
             // if the table is full, push it into the vector
-            if (index_in_content_data >= def::max_key_number) {
+            if (current_content->dataSize() >= sstable_target_size) {
                 // prepare header and bloomfilter
                 collect_data_for_content();
 
                 // reset the state
-                filter.clear();
-                index_in_content_data = 0;
                 current_content = new ssTableContent;
             }
         }
 
         // the last data
-        if (index_in_content_data) {
+        if (!current_content->data.empty()) {
             collect_data_for_content();
         }
         else {
             delete current_content;
         }
 
-        // release memory
-        for (SSTable* table : contents) {
-            delete table;
+        // release memory, while the cached tables may still be read until they leave the levels
+        for (size_t i = 0; i < file_number; ++i) {
+            if (!files[i].table_cache) delete contents[i];
         }
 
         return merged_contents;
     }
 
-    void levelManager::checkCompaction(size_t level) {
+    void levelManager::checkCompaction(size_t level, std::shared_mutex& level_mutex) {
         assert(level_number > level);
         if (levels[level].size() <= def::maxLevelSize(level)) return;
 
@@ -259,7 +394,7 @@ namespace levelmanager {
 
         // if the next level doesn't exist, create it
         size_t next_level = level + 1;
-        createNewLevelIfNonexist(next_level);
+        createNewLevelIfNonexist(next_level, level_mutex);
 
         // iterate through these files and merge them with files in the following level
         std::vector<managerFileDetail> files;
@@ -287,89 +422,150 @@ namespace levelmanager {
                 ++j;
             }
 
-            // write these SSTables into storage
+            // write these SSTables into storage, and the new files of both levels are
+            // prepared with their models while readers still read the old ones
+            manifest::versionEdit edit;
             std::vector<ssTableContent*> contents_to_insert = mergeSSTable(files, remove_deleted_pair);
-            size_t merged_file_size = contents_to_insert.size();
-            for (size_t no = merged_file_size; no; --no) {
-                writeIntoLevel(contents_to_insert[no - 1], next_level, i);
+            level_files next_level_files(levels[next_level].begin(), 
+                levels[next_level].begin() + i);
+            for (ssTableContent* content : contents_to_insert) {
+                next_level_files.push_back(writeIntoLevel(content, next_level, edit));
+            }
+            next_level_files.insert(next_level_files.end(), levels[next_level].begin() + j, 
+                levels[next_level].end());
+            level_files current_level_files_left;
+            for (const managerFileDetail& current_file : levels[level]) {
+                if (current_file.file_name != file_detail.file_name) {
+                    current_level_files_left.push_back(current_file);
+                }
+            }
+            sstable::learnedIndex next_level_model = buildLevelModel(next_level_files, 
+                next_level);
+            sstable::learnedIndex current_level_model = buildLevelModel(
+                current_level_files_left, level);
+
+            // the merged files replace the old ones in one edit, and only then are the old
+            // ones deleted, so a crash leaves either of them
+            for (const managerFileDetail& merged_file : files) {
+                edit.removeFile(merged_file.file_name == file_detail.file_name ? level : 
+                    next_level, baseName(merged_file.file_name));
+            }
+            syncLevel(next_level);
+            manifest_log.append(edit);
+
+            // readers wait only while the levels are swapped
+            {
+                std::unique_lock<std::shared_mutex> lock(level_mutex);
+                levels[next_level].swap(next_level_files);
+                levels[level].swap(current_level_files_left);
+                level_models[next_level] = std::move(next_level_model);
+                level_models[level] = std::move(current_level_model);
             }
 
-            // delete files in level 1
-            i += merged_file_size; j += merged_file_size;
-            for (size_t no = i; no < j; ++no) {
-                utils::rmfile(levels[next_level][no].file_name);
+            // no reader reaches the old files since then
+            for (const managerFileDetail& merged_file : files) {
+                if (merged_file.table_cache) delete merged_file.table_cache;
+                utils::rmfile(merged_file.file_name);
             }
-            levels[next_level].erase(levels[next_level].begin() + i, levels[next_level].begin() + j);
-            utils::rmfile(file_detail.file_name);
             files.clear();
         }
 
-        // erase files in the deque of current level
-        auto removed_file_function = [&files_to_be_merged](const managerFileDetail& file) -> bool {
-            auto it = files_to_be_merged.begin(), eit = files_to_be_merged.end();
-            for (; it != eit; ++it) {
-                if (it->file_name == file.file_name) return true;
-            }
-            return false;
-        };
-        auto it = std::remove_if(levels[level].begin(), levels[level].end(), 
-            removed_file_function);
-        levels[level].erase(it, levels[level].end());
-
         // continue to check the next level
-        checkCompaction(next_level);
+        checkCompaction(next_level, level_mutex);
     }
 
-    void levelManager::writeIntoLevel(ssTableContent* content, size_t level, size_t pos) {
+    managerFileDetail levelManager::writeIntoLevel(ssTableContent* content, size_t level, 
+        manifest::versionEdit& edit) {
         // the size of the vector should be equal to level_number
         assert(level_number > level);
         assert(levels.size() == level_number);
         assert(levels_time.size() == level_number);
 
+        // the encoding of the blocks is chosen, and the filters are built for the level
+        content->header.flags = static_cast<uint32_t>(sstable_filter);
+        if (sstable_packed_blocks) content->header.flags |= def::sstable_packed_block_flag;
+        if (learned_index) content->header.flags |= def::sstable_learned_index_flag;
+        sstable::buildFilter(content, filterBitsPerKey(level));
+        if (range_filter_bits_per_key > 0) {
+            sstable::buildRangeFilter(content, range_filter_bits_per_key);
+        }
+
         // if the mem_table is full, create a sstable
         std::string file_name = file_prefix + '-' + std::to_string(levels_time[level]++);
         SSTable* table = new SSTable(directory_name, content->header.time, level, file_name);
-        table->write(content);
+        table->write(content, sstable_block_size, level >= compression_start_level ? 
+            sstable_compression : def::compression_type::none);
+        if (sync_files && utils::syncFile(table->getFileName()) != 0) {
+            throw exception::sstable_io_error();
+        }
 
         // create a instance of managerFileDetail
-        managerFileDetail new_file_detail { table->getFileName(), content->header };
+        managerFileDetail new_file_detail { table->getFileName(), table->tableHeader() };
+        edit.addFile(level, baseName(new_file_detail.file_name), new_file_detail.header);
 
         // determine whether the SSTable is to be cached
         if (level < def::cached_levels) {
             // if yes, assign it to new_file_detail.table_cache
             new_file_detail.table_cache = table;
+            table->cacheKeys(cached_layout, def::maxCachedKeyNumber(sstable_target_size));
         }
         else {
             // if not, just deleting it is ok
             delete table;
         }
+        return new_file_detail;
+    }
 
-        // insert into the vector
-        levels[level].insert(levels[level].begin() + pos, new_file_detail);
+    double levelManager::filterBitsPerKey(size_t level) const {
+        // Monkey: the false positive rates are best proportional to the sizes of the levels,
+        // so each level gets ln(T) / ln(2)^2 more bits than the one T times larger below it,
+        // where the deepest level holds most keys and decides the memory
+        size_t deepest_level = std::max(level_number, level + 1) - 1;
+        double size_ratio = (double)def::maxLevelSize(deepest_level) / def::maxLevelSize(level);
+        return filter_bits_per_key + std::log(size_ratio) / (M_LN2 * M_LN2);
     }
 
-    void levelManager::createNewLevelIfNonexist(size_t level) {
+    void levelManager::createNewLevelIfNonexist(size_t level, std::shared_mutex& level_mutex) {
         // if the last level is full, new level will be created
         if (level_number <= level) [[unlikely]] {
             // only one more level once is allowed
             assert(level_number == level);
-            utils::mkdir(def::getLevelDirectoryPath(directory_name, level_number++));
+            utils::mkdir(def::getLevelDirectoryPath(directory_name, level));
+            if (sync_files && utils::syncDir(directory_name) != 0) {
+                throw exception::sstable_io_error();
+            }
+
+            // readers go through all levels, which mustn't grow under them
+            std::unique_lock<std::shared_mutex> lock(level_mutex);
+            ++level_number;
             levels.push_back(level_files());
             levels_time.push_back(0);
+            level_models.emplace_back(def::learned_index_error);
         }
         assert(levels.size() == level_number);
         assert(levels_time.size() == level_number);
     }
 
-    void levelManager::writeIntoSSTableFile(ssTableContent* content) {
+    void levelManager::writeIntoSSTableFile(ssTableContent* content, 
+        std::shared_mutex& level_mutex) {
         // if the level doesn't exist, create it
-        createNewLevelIfNonexist(0);
-
-        // write the content into the first level
-        writeIntoLevel(content, 0);
+        createNewLevelIfNonexist(0, level_mutex);
+
+        // write the content into the first level, which readers see once it's complete
+        manifest::versionEdit edit;
+        managerFileDetail new_file_detail = writeIntoLevel(content, 0, edit);
+        syncLevel(0);
+        manifest_log.append(edit);
+        {
+            std::unique_lock<std::shared_mutex> lock(level_mutex);
+            levels[0].push_front(new_file_detail);
+        }
 
         // check compaction for the level
-        checkCompaction(0);
+        checkCompaction(0, level_mutex);
+
+        // the edits are compacted only when all levels are complete again
+        if (manifest_log.needsRewrite()) rewriteManifest();
     }
 
     void levelManager::removeSSTableFile(const std::string& file_name, size_t level) {
@@ -388,8 +584,12 @@ namespace levelmanager {
         assert(it != eit);
 
         // remove from deque
+        manifest::versionEdit edit;
+        edit.removeFile(level, baseName(it->file_name));
+        manifest_log.append(edit);
         if (it->table_cache) delete it->table_cache;
         levels[level].erase(it);
+        buildLevelModels();
     }
 
     void levelManager::updatePrefix() {
@@ -2,9 +2,12 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <shared_mutex>
 #include <string>
 #include <vector>
 #include "../common/definitions.h"
+#include "../common/options.h"
+#include "../manifest/manifest.h"
 #include "../ssTable/ssTable.h"
 
 namespace levelmanager {
@@ -16,7 +19,6 @@ namespace levelmanager {
     using def::pq_type;
     using def::key_type;
     using sstable::SSTable;
-    using bloomFilter = bloomfilter::bloomFilter<key_type>;
 
     class levelManager
     {
@@ -34,31 +36,76 @@ namespace levelmanager {
         // the string is a unique prefix for levelManager
         std::string file_prefix = "";
 
-        // function to sort files
-        level_files sortFiles(const std::vector<std::string>& files, size_t level) const;
+        // the filter written into SSTables, and its bits for each key in the deepest level
+        def::filter_type sstable_filter;
+        double filter_bits_per_key, range_filter_bits_per_key;
+        double filterBitsPerKey(size_t level) const;
 
-        // deal with compaction
-        void checkCompaction(size_t level);
+        // the bytes of data a merged SSTable is filled with, and the bytes of its blocks
+        size_t sstable_target_size, sstable_block_size;
+        bool sstable_packed_blocks;
 
-        // compaction among some managerFileDetail
+        // the codec of the blocks of the levels from compression_start_level on
+        def::compression_type sstable_compression;
+        size_t compression_start_level;
+
+        // the models predicting which file of a level a key is in, which are built over
+        // the max keys of the files whenever the files change
+        bool learned_index;
+
+        // how the keys of cached tables are searched
+        def::cached_table_layout cached_layout;
+        std::vector<sstable::learnedIndex> level_models;
+        sstable::learnedIndex buildLevelModel(const level_files& files, size_t level) const;
+        void buildLevelModels();
+
+        // whether new tables and their directories are synced before their edits, which
+        // is done unless the writes aren't synced either
+        bool sync_files;
+
+        // the files of each level are recorded by the edits in the manifest, and a file
+        // written or removed by a flush or compaction is only a part of the levels or not
+        // once its edit is there
+        manifest::manifestLog manifest_log;
+        void rewriteManifest();
+
+        // ATTENTION! the tables added to the level by an edit must be on the disk before
+        // the edit is appended, or the edit may survive a crash while they don't
+        void syncLevel(size_t level) const;
+
+        // function to sort files, whose headers are read already
+        void sortFiles(level_files& current_level, size_t level) const;
+
+        // deal with compaction, which merges the tables without level_mutex and takes it
+        // exclusively only to replace them in the levels
+        void checkCompaction(size_t level, std::shared_mutex& level_mutex);
+
+        // compaction among some managerFileDetail, whose cached tables are left to the caller
         std::vector<ssTableContent*> mergeSSTable(const std::vector<managerFileDetail>& files, 
             bool remove_deleted_pair) const;
 
-        // internal funtion to write SSTable into a specific level
-        void writeIntoLevel(ssTableContent* content, size_t level, size_t pos = 0);
-        void createNewLevelIfNonexist(size_t level);
+        // internal funtion to write SSTable for a specific level, which is added to the edit
+        // but not yet to the level
+        managerFileDetail writeIntoLevel(ssTableContent* content, size_t level, 
+            manifest::versionEdit& edit);
+        void createNewLevelIfNonexist(size_t level, std::shared_mutex& level_mutex);
 
     public:
-        levelManager(const std::string& dir);
+        levelManager(const std::string& dir, const def::storeOptions& options);
         ~levelManager();
 
         void scanLevels();
         const level_files& getLevelFiles(size_t level) const;
 
+        // the first file in a level other than 0 whose max key isn't less than the key
+        size_t findFile(size_t level, const key_type& key) const;
+
         size_t size() const;
         void clear();
 
-        void writeIntoSSTableFile(ssTableContent* content);
+        // ATTENTION! the caller must be the only one changing the levels, which are read by
+        // the others while they hold level_mutex shared
+        void writeIntoSSTableFile(ssTableContent* content, std::shared_mutex& level_mutex);
         void removeSSTableFile(const std::string& file_name, size_t level);
 
         void updatePrefix();
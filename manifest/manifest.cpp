@@ -0,0 +1,195 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "manifest.h"
+#include "../common/exceptions.h"
+#include "../utils.h"
+
+namespace manifest {
+
+    // a record is a uint32_t payload length, a crc16 of the payload and the payload
+    static const size_t record_header_size = sizeof(uint32_t) + sizeof(uint16_t);
+
+    static std::string frameRecord(const std::string& payload) {
+        uint32_t length = static_cast<uint32_t>(payload.length());
+        uint16_t check_sum = utils::crc16((const unsigned char*)payload.data(), length);
+        std::string record;
+        record.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        record.append(reinterpret_cast<const char*>(&check_sum), sizeof(check_sum));
+        record.append(payload);
+        return record;
+    }
+
+    void versionEdit::addFile(size_t level, const std::string& name,
+        const def::ssTableHeader& header) {
+        // each file edit is the kind, the level, the name length, the name and the header
+        uint32_t level_number = static_cast<uint32_t>(level);
+        uint16_t name_length = static_cast<uint16_t>(name.length());
+        payload.push_back(static_cast<char>(edit_kind::add_file));
+        payload.append(reinterpret_cast<const char*>(&level_number), sizeof(level_number));
+        payload.append(reinterpret_cast<const char*>(&name_length), sizeof(name_length));
+        payload.append(name);
+        payload.append(reinterpret_cast<const char*>(&header), def::sstable_header_size);
+    }
+
+    void versionEdit::removeFile(size_t level, const std::string& name) {
+        // a removed file has no header
+        uint32_t level_number = static_cast<uint32_t>(level);
+        uint16_t name_length = static_cast<uint16_t>(name.length());
+        payload.push_back(static_cast<char>(edit_kind::remove_file));
+        payload.append(reinterpret_cast<const char*>(&level_number), sizeof(level_number));
+        payload.append(reinterpret_cast<const char*>(&name_length), sizeof(name_length));
+        payload.append(name);
+    }
+
+    void versionEdit::decode(const std::string& payload, const edit_visitor& visitor) {
+        size_t pos = 0;
+        while (pos < payload.size()) {
+            edit_kind kind;
+            uint32_t level;
+            uint16_t name_length;
+            def::ssTableHeader header{};
+            def::read_from_buffer((char*)&kind, (char*)payload.data(), sizeof(kind), pos);
+            def::read_from_buffer((char*)&level, (char*)payload.data(), sizeof(level), pos);
+            def::read_from_buffer((char*)&name_length, (char*)payload.data(),
+                sizeof(name_length), pos);
+            std::string name = payload.substr(pos, name_length);
+            pos += name_length;
+            if (kind == edit_kind::add_file) {
+                def::read_from_buffer((char*)&header, (char*)payload.data(),
+                    def::sstable_header_size, pos);
+            }
+            visitor(kind, level, name, header);
+        }
+    }
+
+    manifestLog::manifestLog(const std::string& dir, bool sync) : sync(sync) {
+        // create directory first
+        if (utils::mkdir(dir) != 0) {
+            throw exception::create_directory_fail();
+        }
+
+        // use a safer way to manage file path
+        std::filesystem::path path(dir);
+        path.append(def::manifest_file_name);
+        file_name = path.string();
+        openLog();
+
+        // the log of the last run is counted as a snapshot until it's rewritten, and an
+        // empty one is only created before a crash, since a rewritten one has a record
+        struct stat st;
+        if (fstat(fd, &st) == 0) log_size = snapshot_size = st.st_size;
+        found = log_size > 0;
+    }
+
+    manifestLog::~manifestLog() {
+        if (fd >= 0) close(fd);
+    }
+
+    void manifestLog::openLog() {
+        fd = open(file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) {
+            perror("open");
+            throw exception::manifest_io_error();
+        }
+    }
+
+    void manifestLog::writeOut(int target_fd, const std::string& buffer) {
+        // write may return early, so loop until all bytes are written
+        size_t written = 0;
+        while (written < buffer.size()) {
+            ssize_t result = write(target_fd, buffer.data() + written, buffer.size() - written);
+            if (result < 0) {
+                if (errno == EINTR) continue;
+                perror("write");
+                throw exception::manifest_io_error();
+            }
+            written += result;
+        }
+    }
+
+    void manifestLog::syncLog(int target_fd) {
+        if (sync && fdatasync(target_fd) != 0) {
+            perror("fdatasync");
+            throw exception::manifest_io_error();
+        }
+    }
+
+    void manifestLog::replay(const edit_visitor& visitor) const {
+        // the log is read at once, since it's compacted whenever it grows too much
+        std::ifstream file_stream(file_name, std::ios::binary);
+        std::string buffer((std::istreambuf_iterator<char>(file_stream)),
+            std::istreambuf_iterator<char>());
+
+        size_t pos = 0;
+        while (pos + record_header_size <= buffer.size()) {
+            uint32_t length;
+            uint16_t check_sum;
+            def::read_from_buffer((char*)&length, buffer.data(), sizeof(length), pos);
+            def::read_from_buffer((char*)&check_sum, buffer.data(), sizeof(check_sum), pos);
+
+            // the record is torn by a crash
+            if (pos + length > buffer.size()) return;
+            if (utils::crc16((const unsigned char*)buffer.data() + pos, length) != check_sum) {
+                return;
+            }
+
+            versionEdit::decode(buffer.substr(pos, length), visitor);
+            pos += length;
+        }
+    }
+
+    void manifestLog::append(const versionEdit& edit) {
+        if (edit.empty()) return;
+        std::string record = frameRecord(edit.getPayload());
+        writeOut(fd, record);
+        syncLog(fd);
+        log_size += record.size();
+    }
+
+    void manifestLog::rewrite(const versionEdit& snapshot) {
+        // an empty snapshot is still a record, so the log always exists afterwards
+        std::string record = frameRecord(snapshot.getPayload());
+        std::string temp_name = file_name + def::manifest_temp_extension_name;
+        int temp_fd = open(temp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (temp_fd < 0) {
+            perror("open");
+            throw exception::manifest_io_error();
+        }
+        try {
+            writeOut(temp_fd, record);
+            syncLog(temp_fd);
+        }
+        catch (...) {
+            close(temp_fd);
+            throw;
+        }
+        close(temp_fd);
+
+        // the rename is the moment the new log replaces the old one
+        if (rename(temp_name.c_str(), file_name.c_str()) != 0) {
+            perror("rename");
+            throw exception::manifest_io_error();
+        }
+        if (sync) {
+            int dir_fd = open(std::filesystem::path(file_name).parent_path().c_str(),
+                O_RDONLY | O_DIRECTORY);
+            if (dir_fd >= 0) {
+                fsync(dir_fd);
+                close(dir_fd);
+            }
+        }
+
+        close(fd);
+        openLog();
+        found = true;
+        log_size = snapshot_size = record.size();
+    }
+
+}
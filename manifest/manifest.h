@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "../common/definitions.h"
+
+namespace manifest {
+
+    // what a version edit does to a file of a level
+    enum class edit_kind : uint8_t {
+        remove_file = 0,
+        add_file = 1,
+    };
+
+    // called with each file edit of the records in the order they were appended, where the
+    // header is only meaningful for an added file
+    using edit_visitor = std::function<void(edit_kind, size_t level, const std::string& name,
+        const def::ssTableHeader& header)>;
+
+    // the files added to and removed from levels by one flush or compaction, which become
+    // visible together, and the file is named without its directory
+    class versionEdit
+    {
+    private:
+        std::string payload;
+
+    public:
+        void addFile(size_t level, const std::string& name, const def::ssTableHeader& header);
+        void removeFile(size_t level, const std::string& name);
+
+        bool empty() const { return payload.empty(); }
+        const std::string& getPayload() const { return payload; }
+
+        // visit all file edits in a payload
+        static void decode(const std::string& payload, const edit_visitor& visitor);
+    };
+
+    // the log of version edits telling which files make up each level, so the levels are
+    // known without opening any table, and a file is only part of a level once the edit
+    // adding it is in the log
+    //
+    // the records are framed like those of write-ahead logs, and a torn record at the end
+    // is ignored, so an edit is replayed all or nothing
+    class manifestLog
+    {
+    private:
+        std::string file_name;
+        int fd = -1;
+        bool sync;
+
+        // whether the log of the last run has any record
+        bool found = false;
+
+        // the bytes of the log, and of the snapshot it starts with
+        size_t log_size = 0, snapshot_size = 0;
+
+        void openLog();
+        void writeOut(int target_fd, const std::string& buffer);
+        void syncLog(int target_fd);
+
+    public:
+        // ATTENTION! with sync the edits are synced, or they only survive crashes of the
+        // process, like the writes with wal_sync_policy::never
+        manifestLog(const std::string& dir, bool sync);
+        ~manifestLog();
+
+        manifestLog(const manifestLog&) = delete;
+        manifestLog& operator=(const manifestLog&) = delete;
+
+        bool exists() const { return found; }
+
+        // replay all complete edits from the oldest to the newest
+        void replay(const edit_visitor& visitor) const;
+
+        // returns once the edit is in the log
+        void append(const versionEdit& edit);
+
+        // replace the whole log with one edit adding all the files, which is written into
+        // another file first and renamed over the log, so a crash leaves either of them
+        void rewrite(const versionEdit& snapshot);
+
+        // edits have piled up far beyond the files they describe
+        bool needsRewrite() const {
+            return log_size > 2 * snapshot_size + def::min_manifest_rewrite_size;
+        }
+    };
+
+}
@@ -1,4 +1,5 @@
 #include "memTable.h"
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <map>
@@ -6,7 +7,12 @@
 
 namespace memtable {
 
-    memTable::memTable(const std::string& dir) : filter(def::bloom_filter_size) {
+    memTable::memTable(const std::string& dir, const def::storeOptions& options) : 
+        data(createMemTableRep(options.memtable_structure)), budget(options.memtable_budget), 
+        inline_value_threshold(options.inline_value_threshold), 
+        sstable_target_size(options.sstable_target_size), 
+        value_compression(options.value_compression), 
+        filter(std::max(budget / def::memtable_filter_ratio, def::bloom_filter_size)) {
         /* here's nothing to do??? */
     }
 
@@ -14,105 +20,120 @@ namespace memtable {
         /* here's nothing to do??? */
     }
 
-    bool memTable::insert(const key_type &key, const value_type &value) {
-        // insert the value
-        data.put(key, value);
+    bool memTable::insert(const key_type &key, value_view value) {
+        // set the filter first, so that a visible key never misses the filter
         filter.insert(key);
+        data->put(key, value);
 
         // whether the size of the table allows more insertion
-        return data.size() < def::max_key_number;
+        return !full();
     }
 
     bool memTable::remove(const key_type &key) {
-        // insert the delete tag
-        data.put(key, def::delete_tag);
+        // insert a tombstone
         filter.insert(key);
+        data->remove(key);
 
         // whether the size of the table allows more insertion
-        return data.size() + 1 <= def::max_key_number;
+        return !full();
+    }
+
+    bool memTable::apply(const key_type& key, const def::entry_view& entry) {
+        return entry.isTombstone() ? remove(key) : insert(key, entry.value);
     }
 
     void memTable::clear() {
-        data.clear();
+        // the structure releases its arena in one shot
+        data->clear();
         filter.clear();
     }
 
-    std::optional<value_type> memTable::get(const key_type& key) const {
+    std::optional<entry_type> memTable::get(const key_type& key) const {
         if (!filter.query(key)) return std::nullopt;
-        return data.get(key);
+        return data->get(key);
     }
 
     void memTable::scan(const key_type& key1, const key_type& key2, 
-        std::map<key_type, value_type>& map) const {
-        // use iterator to scan
-        skiplist::skiplist_type::const_iterator it = data.cbegin(), eit = data.cend();
-
-        // scan through all contents
-        for (; it != eit; ++it) {
-            // assertion, not meet the end
-            assert(it != eit);
-
-            // fetch content and then write
-            key_type key = it.key();
-
-            // if the pair is ok
-            if (key <= key2 && key >= key1) {
-                // replace is not allowed
-                map[key] = it.value();
-            }
-            // if those left keys are larger than key2
-            else if (key > key2) {
-                break;
-            }
-        }
+        std::map<key_type, entry_type>& map) const {
+        data->scan(key1, key2, [&map](const key_type& key, const entry_view& entry) {
+            // replace is not allowed, newer tables are scanned earlier
+            auto [it, inserted] = map.try_emplace(key);
+            if (inserted) it->second = entry_type{ entry.kind, value_type(entry.value) };
+        });
     }
 
-    // ATTENTION! the content is allocated on the heap, so please remember to delete it
-    ssTableContent* memTable::getContent(vlog::vLog& v_log) const {
-        // here we new an array of char, please remember to delete it
-        ssTableContent* content = new ssTableContent;
-        
-        // header of the SSTable file
-        content->header.time = cur_timestamp;
-        content->header.key_value_pair_number = data.size();
-
-        // bloom filter
-        memcpy(&content->bloomFilterContent, filter.getContent(), def::bloom_filter_size);
-
-        // all contents
-        skiplist::skiplist_type::const_iterator it = data.cbegin(), 
-            old_it = it, eit = data.cend();
-        content->header.min_key = it.key();
-
-        for (size_t i = 0; i < content->header.key_value_pair_number; ++i, old_it = it++) {
-            // assertion, not meet the end
-            assert(it != eit);
-
-            // fetch content and then write
-            key_type key = it.key();
-            value_type val = it.value();
+    // ATTENTION! the contents are allocated on the heap, so please remember to delete them
+    std::vector<ssTableContent*> memTable::getContent(vlog::vLog& v_log) const {
+        std::vector<ssTableContent*> contents;
+        ssTableContent* content = nullptr;
+
+        // values going to vlog are written at once after all contents are built, when
+        // their offsets and the bytes they take are known
+        std::vector<std::pair<key_type, value_view>> v_log_entries;
+
+        // a lambda function to set header and then push content into the vector, and the
+        // filter is built by levelManager for the level the table goes to
+        auto collect_data_for_content = [&]() {
+            // min key and max key are the first and the last one
+            content->header.time = cur_timestamp;
+            content->header.key_value_pair_number = content->data.size();
+            content->header.min_key = content->data.front().key;
+            content->header.max_key = content->data.back().key;
+
+            contents.push_back(content);
+            content = nullptr;
+        };
+
+        // the table is sized by bytes rather than keys, so the contents are split into
+        // as many SSTables as needed, all of which have the same timestamp
+        data->forEach([&](const key_type& key, const entry_view& entry) {
+            // here we new a content, please remember to delete it
+            if (!content) content = new ssTableContent;
 
             // set content
-            content->data[i].key = key;
+            def::ssTableData& table_data = content->data.emplace_back();
+            table_data.key = key;
+            value_view val = entry.value;
             // if the pair is a deleted one
-            if (val == def::delete_tag) {
-                content->data[i].offset = 0;
-                content->data[i].value_length = 0;
+            if (entry.isTombstone()) {
+                table_data.offset = 0;
+                table_data.value_length = 0;
+            }
+            // store a small value in the SSTable itself, and so is an empty value
+            else if (val.length() < inline_value_threshold || val.empty()) {
+                table_data.offset = content->appendInlineValue(val);
+                table_data.value_length = 
+                    static_cast<uint32_t>(val.length()) | def::inline_value_flag;
             }
-            // insert the value into vlog and get offset
+            // the value goes to vlog
             else {
-                content->data[i].offset = v_log.append(key, val);
-                content->data[i].value_length = static_cast<uint32_t>(val.length());
+                table_data.offset = 0;
+                table_data.value_length = static_cast<uint32_t>(val.length());
+                v_log_entries.emplace_back(key, val);
             }
-        }
-
-        // assertion
-        assert(it == eit);
 
-        // max key is the last one
-        content->header.max_key = old_it.key();
+            // the SSTable is full
+            if (content->dataSize() >= sstable_target_size) collect_data_for_content();
+        });
+
+        // the last data
+        if (content) collect_data_for_content();
+
+        // write all values into vlog in one shot, and then fix the offsets and lengths,
+        // which are in the same order as the values
+        if (v_log_entries.empty()) return contents;
+        std::vector<vlog::entry_location> locations = 
+            v_log.appendBatch(v_log_entries, value_compression);
+        size_t next_location = 0;
+        for (ssTableContent* table_content : contents) {
+            for (def::ssTableData& table_data : table_content->data) {
+                if (table_data.value_length && !def::isInlineValue(table_data)) {
+                    table_data.offset = locations[next_location].first;
+                    table_data.value_length = locations[next_location++].second;
+                }
+            }
+        }
 
-        return content;
+        return contents;
     }
 }
-
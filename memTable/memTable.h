@@ -1,48 +1,71 @@
 #pragma once
 
-#include "../skipList/skipList.h"
+#include "memTableRep.h"
 #include "../bloomFilter/bloomFilter.h"
 #include "../common/definitions.h"
+#include "../common/options.h"
 #include "../ssTable/ssTable.h"
 #include "../vLog/vLog.h"
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <utility>
 #include <map>
+#include <vector>
 
 namespace memtable {
 
     using def::value_type;
     using def::key_type;
+    using def::entry_type;
     using def::ssTableContent;
     using sstable::SSTable;
-    using bloomFilter = bloomfilter::bloomFilter<key_type>;
+    using blockedBloomFilter = bloomfilter::blockedBloomFilter<key_type>;
 
+    // ATTENTION! insert, remove, get and scan may be called by many threads at the same
+    // time, while clear and getContent need exclusive access to the memTable
     class memTable
     {
     private:
-        skiplist::skiplist_type data;
+        std::unique_ptr<memTableRep> data;
         uint64_t cur_timestamp = 0;
 
-        // bloomFilter here
-        bloomFilter filter;
+        // the table is full once its memory reaches the budget
+        size_t budget;
+
+        // values shorter than it are stored in SSTables when flushed
+        size_t inline_value_threshold;
+
+        // the bytes of data an SSTable is filled with when flushed
+        size_t sstable_target_size;
+
+        // the codec of the values going to vLog
+        def::compression_type value_compression;
+
+        // a probe of the filter touches only one cache line
+        blockedBloomFilter filter;
 
     public:
-        explicit memTable(const std::string& dir);
+        memTable(const std::string& dir, const def::storeOptions& options);
         ~memTable();
 
-        bool insert(const key_type& key, const value_type& value);
+        bool insert(const key_type& key, value_view value);
         bool remove(const key_type& key);
-        std::optional<value_type> get(const key_type& key) const;
+
+        // insert a value or a tombstone
+        bool apply(const key_type& key, const def::entry_view& entry);
+        std::optional<entry_type> get(const key_type& key) const;
         void scan(const key_type& key1, const key_type& key2, 
-            std::map<key_type, value_type>& map) const;
+            std::map<key_type, entry_type>& map) const;
         void clear();
 
-        ssTableContent* getContent(vlog::vLog& v_log) const;
+        std::vector<ssTableContent*> getContent(vlog::vLog& v_log) const;
 
-        size_t size() const { return data.size(); }
-        bool empty() const { return data.size() == 0; }
+        size_t size() const { return data->size(); }
+        bool full() const { return memoryUsage() >= budget; }
+        size_t memoryUsage() const { return data->memoryUsage(); }
+        bool empty() const { return data->size() == 0; }
 
         void setTimestamp(uint64_t new_timestamp) { cur_timestamp = new_timestamp; }
         uint64_t getTimestamp() const { return cur_timestamp; }
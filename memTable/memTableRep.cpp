@@ -0,0 +1,228 @@
+#include "memTableRep.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+namespace memtable {
+
+    // the approximate bytes each entry of std::unordered_map takes besides the value
+    const size_t hash_node_overhead = 32;
+
+    std::unique_ptr<memTableRep> createMemTableRep(def::memtable_type type) {
+        switch (type) {
+            case def::memtable_type::hash_table:
+                return std::make_unique<hashTableRep>();
+            case def::memtable_type::bplus_tree:
+                return std::make_unique<bPlusTreeRep>();
+            case def::memtable_type::skiplist:
+            default:
+                return std::make_unique<skipListRep>();
+        }
+    }
+
+    /* skipListRep */
+
+    void skipListRep::put(const key_type& key, value_view val) {
+        data.put(key, val);
+    }
+
+    void skipListRep::remove(const key_type& key) {
+        data.remove(key);
+    }
+
+    std::optional<entry_type> skipListRep::get(const key_type& key) const {
+        return data.get(key);
+    }
+
+    void skipListRep::scan(const key_type& key1, const key_type& key2,
+        const entry_visitor& visitor) const {
+        // seek to the first key not less than key1 instead of walking from the head
+        auto it = data.lower_bound(key1), eit = data.cend();
+        for (; it != eit && it.key() <= key2; ++it) {
+            visitor(it.key(), *it);
+        }
+    }
+
+    void skipListRep::forEach(const entry_visitor& visitor) const {
+        for (auto it = data.cbegin(), eit = data.cend(); it != eit; ++it) {
+            visitor(it.key(), *it);
+        }
+    }
+
+    void skipListRep::clear() {
+        data.clear();
+    }
+
+    /* hashTableRep */
+
+    // the cost of ordering is only paid when entries are scanned or flushed
+    static void sortEntries(std::vector<std::pair<key_type, const char*>>& entries) {
+        std::sort(entries.begin(), entries.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+    }
+
+    hashTableRep::shard& hashTableRep::shardOf(const key_type& key) {
+        // the multiplication mixes the keys, which std::hash leaves as they are
+        return shards[((key * 0x9e3779b97f4a7c15ull) >> 32) % shard_number];
+    }
+
+    const hashTableRep::shard& hashTableRep::shardOf(const key_type& key) const {
+        return const_cast<hashTableRep*>(this)->shardOf(key);
+    }
+
+    void hashTableRep::put(const key_type& key, value_view val) {
+        shard& table_shard = shardOf(key);
+        std::unique_lock<std::shared_mutex> lock(table_shard.mutex);
+
+        // the old value is abandoned in the arena until the arena is reset
+        uint32_t length = static_cast<uint32_t>(val.length());
+        char* record = table_shard.pool.allocateAligned(sizeof(length) + length, 
+            alignof(uint32_t));
+        memcpy(record, &length, sizeof(length));
+        memcpy(record + sizeof(length), val.data(), length);
+        putRecord(table_shard, key, record);
+    }
+
+    void hashTableRep::remove(const key_type& key) {
+        shard& table_shard = shardOf(key);
+        std::unique_lock<std::shared_mutex> lock(table_shard.mutex);
+        putRecord(table_shard, key, nullptr);
+    }
+
+    void hashTableRep::putRecord(shard& table_shard, const key_type& key, const char* record) {
+        table_shard.data[key] = record;
+
+        // values, nodes and buckets
+        table_shard.memory_usage.store(table_shard.pool.memoryUsage() + 
+            table_shard.data.size() * hash_node_overhead +
+            table_shard.data.bucket_count() * sizeof(void*), std::memory_order_relaxed);
+    }
+
+    std::optional<entry_type> hashTableRep::get(const key_type& key) const {
+        const shard& table_shard = shardOf(key);
+        std::shared_lock<std::shared_mutex> lock(table_shard.mutex);
+
+        auto it = table_shard.data.find(key);
+        if (it == table_shard.data.end()) return std::nullopt;
+        entry_view entry = def::recordEntry(it->second);
+        return entry_type{ entry.kind, value_type(entry.value) };
+    }
+
+    void hashTableRep::collectEntries(const shard& table_shard, const key_type& key1, 
+        const key_type& key2, std::vector<std::pair<key_type, const char*>>& entries) {
+        for (const auto& entry : table_shard.data) {
+            if (entry.first >= key1 && entry.first <= key2) entries.push_back(entry);
+        }
+    }
+
+    void hashTableRep::scan(const key_type& key1, const key_type& key2,
+        const entry_visitor& visitor) const {
+        // a range shorter than the table is probed key by key, which finds them in order,
+        // and otherwise each shard is only locked while its entries are collected
+        std::vector<std::pair<key_type, const char*>> entries;
+        if (key2 - key1 < size()) {
+            for (key_type key = key1; ; ++key) {
+                const shard& table_shard = shardOf(key);
+                std::shared_lock<std::shared_mutex> lock(table_shard.mutex);
+                auto it = table_shard.data.find(key);
+                if (it != table_shard.data.end()) entries.push_back(*it);
+                if (key == key2) break;
+            }
+        }
+        else {
+            for (const shard& table_shard : shards) {
+                std::shared_lock<std::shared_mutex> lock(table_shard.mutex);
+                collectEntries(table_shard, key1, key2, entries);
+            }
+            sortEntries(entries);
+        }
+
+        for (const auto& entry : entries) {
+            visitor(entry.first, def::recordEntry(entry.second));
+        }
+    }
+
+    void hashTableRep::forEach(const entry_visitor& visitor) const {
+        // sort once when the table is flushed
+        std::vector<std::pair<key_type, const char*>> entries;
+        for (const shard& table_shard : shards) {
+            collectEntries(table_shard, 0, UINT64_MAX, entries);
+        }
+        sortEntries(entries);
+
+        for (const auto& entry : entries) {
+            visitor(entry.first, def::recordEntry(entry.second));
+        }
+    }
+
+    void hashTableRep::clear() {
+        for (shard& table_shard : shards) {
+            table_shard.data.clear();
+            table_shard.pool.reset();
+            table_shard.memory_usage = 0;
+        }
+    }
+
+    size_t hashTableRep::size() const {
+        size_t result = 0;
+        for (const shard& table_shard : shards) {
+            std::shared_lock<std::shared_mutex> lock(table_shard.mutex);
+            result += table_shard.data.size();
+        }
+        return result;
+    }
+
+    size_t hashTableRep::memoryUsage() const {
+        size_t result = 0;
+        for (const shard& table_shard : shards) {
+            result += table_shard.memory_usage.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    /* bPlusTreeRep */
+
+    void bPlusTreeRep::put(const key_type& key, value_view val) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        data.put(key, val);
+        memory_usage.store(data.memoryUsage(), std::memory_order_relaxed);
+    }
+
+    void bPlusTreeRep::remove(const key_type& key) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        data.remove(key);
+        memory_usage.store(data.memoryUsage(), std::memory_order_relaxed);
+    }
+
+    std::optional<entry_type> bPlusTreeRep::get(const key_type& key) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return data.get(key);
+    }
+
+    void bPlusTreeRep::scan(const key_type& key1, const key_type& key2,
+        const entry_visitor& visitor) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+
+        auto it = data.lower_bound(key1), eit = data.cend();
+        for (; it != eit && it.key() <= key2; ++it) {
+            visitor(it.key(), *it);
+        }
+    }
+
+    void bPlusTreeRep::forEach(const entry_visitor& visitor) const {
+        for (auto it = data.cbegin(), eit = data.cend(); it != eit; ++it) {
+            visitor(it.key(), *it);
+        }
+    }
+
+    void bPlusTreeRep::clear() {
+        data.clear();
+        memory_usage = 0;
+    }
+
+    size_t bPlusTreeRep::size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return data.size();
+    }
+
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include "../arena/arena.h"
+#include "../bPlusTree/bPlusTree.h"
+#include "../common/definitions.h"
+#include "../common/options.h"
+#include "../skipList/skipList.h"
+
+namespace memtable {
+
+    using def::key_type;
+    using def::value_type;
+    using def::value_view;
+    using def::entry_type;
+    using def::entry_view;
+
+    // called with each entry in key order
+    using entry_visitor = std::function<void(const key_type&, const entry_view&)>;
+
+    // the structure a memTable stores its entries in
+    // ATTENTION! put, remove, get and scan may be called by many threads at the same time,
+    // while clear and forEach need exclusive access
+    class memTableRep
+    {
+    public:
+        virtual ~memTableRep() = default;
+
+        virtual void put(const key_type& key, value_view val) = 0;
+        virtual std::optional<entry_type> get(const key_type& key) const = 0;
+
+        // a tombstone takes no space for the value
+        virtual void remove(const key_type& key) = 0;
+
+        // visit the entries in [key1, key2] in key order
+        virtual void scan(const key_type& key1, const key_type& key2,
+            const entry_visitor& visitor) const = 0;
+        // visit all entries in key order
+        virtual void forEach(const entry_visitor& visitor) const = 0;
+
+        virtual void clear() = 0;
+
+        virtual size_t size() const = 0;
+        virtual size_t memoryUsage() const = 0;
+    };
+
+    // create the structure chosen by options
+    std::unique_ptr<memTableRep> createMemTableRep(def::memtable_type type);
+
+    // lock-free writers and readers, ordered all the time
+    class skipListRep : public memTableRep
+    {
+    private:
+        skiplist::skiplist_type data;
+
+    public:
+        void put(const key_type& key, value_view val) override;
+        void remove(const key_type& key) override;
+        std::optional<entry_type> get(const key_type& key) const override;
+        void scan(const key_type& key1, const key_type& key2,
+            const entry_visitor& visitor) const override;
+        void forEach(const entry_visitor& visitor) const override;
+        void clear() override;
+
+        size_t size() const override { return data.size(); }
+        size_t memoryUsage() const override { return data.memoryUsage(); }
+    };
+
+    // O(1) put and get, entries are only sorted when they are scanned or flushed
+    class hashTableRep : public memTableRep
+    {
+    private:
+        // the keys are spread over shards, each with its own lock and arena, so writers
+        // only wait for those of the same shard
+        static constexpr size_t shard_number = 16;
+        struct shard {
+            // keys map to value records in the arena, see def::recordEntry
+            std::unordered_map<key_type, const char*> data;
+            arena::bumpArena pool;
+
+            // writers are excluded from each other and from readers of the shard
+            mutable std::shared_mutex mutex;
+            std::atomic<size_t> memory_usage = 0;
+        };
+        std::array<shard, shard_number> shards;
+
+        shard& shardOf(const key_type& key);
+        const shard& shardOf(const key_type& key) const;
+
+        // collect entries in [key1, key2] of a shard
+        static void collectEntries(const shard& table_shard, const key_type& key1, 
+            const key_type& key2, std::vector<std::pair<key_type, const char*>>& entries);
+
+        // ATTENTION! the caller must hold the mutex of the shard exclusively
+        static void putRecord(shard& table_shard, const key_type& key, const char* record);
+
+    public:
+        void put(const key_type& key, value_view val) override;
+        void remove(const key_type& key) override;
+        std::optional<entry_type> get(const key_type& key) const override;
+        void scan(const key_type& key1, const key_type& key2,
+            const entry_visitor& visitor) const override;
+        void forEach(const entry_visitor& visitor) const override;
+        void clear() override;
+
+        size_t size() const override;
+        size_t memoryUsage() const override;
+    };
+
+    // ordered like skiplist, but with wide nodes that keep searching within cache lines
+    class bPlusTreeRep : public memTableRep
+    {
+    private:
+        bplustree::bplustree_type data;
+
+        // writers are excluded from each other and from readers
+        mutable std::shared_mutex mutex;
+        std::atomic<size_t> memory_usage = 0;
+
+    public:
+        void put(const key_type& key, value_view val) override;
+        void remove(const key_type& key) override;
+        std::optional<entry_type> get(const key_type& key) const override;
+        void scan(const key_type& key1, const key_type& key2,
+            const entry_visitor& visitor) const override;
+        void forEach(const entry_visitor& visitor) const override;
+        void clear() override;
+
+        size_t size() const override;
+        size_t memoryUsage() const override { return memory_usage.load(std::memory_order_relaxed); }
+    };
+
+}
@@ -1,123 +1,160 @@
 #include "skipList.h"
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <thread>
 
 namespace skiplist {
 
     skiplist_type::skiplist_type(double p) : p(p) {
-        head = new baseDataNode();
-        head->addNewSearchNode();
+        head = newNode(key_type{}, max_height, nullptr);
     }
 
     skiplist_type::~skiplist_type() {
-        while (head->nextNode()) {
-            baseDataNode* next_node = head->nextNode();
-            head->nextNode() = next_node->nextNode();
-            delete next_node;
+        // all nodes are released together with the arena
+    }
+
+    dataNode* skiplist_type::newNode(const key_type& key, size_t height, const char* value) {
+        // the key and the whole tower are allocated only once
+        char* mem = pool.allocateConcurrently(dataNode::allocationSize(height), alignof(dataNode));
+        dataNode* node = new (mem) dataNode;
+
+        node->key = key;
+        node->value.store(value, std::memory_order_relaxed);
+        node->height = static_cast<uint32_t>(height);
+        for (size_t i = 0; i < height; ++i) {
+            new (&node->next_nodes[i]) std::atomic<dataNode*>(nullptr);
         }
-        delete head;
+
+        return node;
+    }
+
+    const char* skiplist_type::newValue(value_view val) {
+        // the old value is abandoned in the arena until the arena is reset
+        uint32_t length = static_cast<uint32_t>(val.length());
+        char* record = pool.allocateConcurrently(sizeof(length) + length, alignof(uint32_t));
+        memcpy(record, &length, sizeof(length));
+        memcpy(record + sizeof(length), val.data(), length);
+        return record;
     }
 
     bool skiplist_type::eventOccur() const {
-        return static_cast<double>(std::rand()) / RAND_MAX <= p;
+        // std::rand isn't thread-safe, so each thread uses its own engine
+        thread_local std::minstd_rand engine(static_cast<std::minstd_rand::result_type>(
+            std::hash<std::thread::id>()(std::this_thread::get_id())));
+        return std::uniform_real_distribution<double>(0, 1)(engine) <= p;
     }
 
-    searchDataNode* skiplist_type::findAndInsert(const key_type& key, const value_type& val, 
-        size_t cur_layer, baseDataNode* cur_base_node) {
+    size_t skiplist_type::randomHeight() const {
+        // at most one more layer than the current height is allowed
+        size_t height = 1, max_allowed = std::min(
+            cur_height.load(std::memory_order_relaxed) + 1, max_height);
+        while (height < max_allowed && eventOccur()) ++height;
+        return height;
+    }
 
-        // continue search
-        if (cur_layer) {
-            // find next node
-            searchDataNode* cur_search_node = cur_base_node->getLayer(cur_layer);
-            while (cur_search_node->next && *(cur_search_node->next->key) <= key) {
-                cur_search_node = cur_search_node->next;
-            }
+    dataNode* skiplist_type::findGreaterOrEqual(const key_type& key, size_t* steps) const {
+        dataNode* cur_node = head;
+        size_t layer = cur_height.load(std::memory_order_relaxed) - 1;
 
-            // assign new index
-            cur_base_node = cur_search_node->parent;
+        while (true) {
+            dataNode* next_node = cur_node->next(layer);
 
-            // find the corresponding key
-            if (cur_search_node->key && *(cur_search_node->key) == key) {
-                // if replace is allowed, replace old value with new value
-                cur_base_node->setValue(val);
-                return nullptr;
+            // keep moving in this layer
+            if (next_node && next_node->key < key) {
+                cur_node = next_node;
+                if (steps) ++*steps;
+                continue;
             }
-            // the key of next node is larger than 'key' or the next node is nullptr
-            else {
-                searchDataNode* next_node = findAndInsert(key, val, cur_layer - 1, cur_base_node);
 
-                // new node created
-                if (next_node) {
-                    next_node->next = cur_search_node->next;
-                    cur_search_node->next = next_node;
+            // already the first layer
+            if (!layer) return next_node;
 
-                    // push up with a certain possibility
-                    if (!eventOccur()) next_node = nullptr;
-                    else next_node = next_node->parent->addNewSearchNode();
-                }
+            // go down to the next layer
+            --layer;
+            if (steps) ++*steps;
+        }
+    }
 
-                return next_node;
+    void skiplist_type::findSpliceForLayer(const key_type& key, size_t layer,
+        dataNode*& prev, dataNode*& succ) const {
+        // prev is where the search starts, and its key is always less than 'key'
+        while (true) {
+            dataNode* next_node = prev->next(layer);
+            if (next_node && next_node->key < key) {
+                prev = next_node;
+            }
+            else {
+                succ = next_node;
+                return;
             }
         }
-        // already the first layer and the key hasn't been found
-        else {
-            baseDataNode* new_base_node = new baseDataNode(key);
-            new_base_node->nextNode() = cur_base_node->nextNode();
-            cur_base_node->nextNode() = new_base_node;
-            new_base_node->setValue(val);
-            ++key_number;
-            return new_base_node->addNewSearchNode();
+    }
+
+    void skiplist_type::findSplice(const key_type& key, size_t top_layer,
+        dataNode** prev, dataNode** succ) const {
+        // the search of each layer starts from the result of the upper layer
+        dataNode* cur_node = head;
+        for (size_t layer = top_layer; layer--; ) {
+            findSpliceForLayer(key, layer, cur_node, succ[layer]);
+            prev[layer] = cur_node;
         }
     }
 
-    std::pair<baseDataNode*, size_t> skiplist_type::find(const key_type& key,
-        size_t cur_layer, baseDataNode* cur_base_node) const {
-        size_t new_steps = 0;
+    void skiplist_type::put(const key_type& key, value_view val) {
+        insert(key, newValue(val));
+    }
 
-        // continue search
-        if (cur_layer) {
-            // find next node
-            searchDataNode* cur_search_node = cur_base_node->getLayer(cur_layer);
-            while (cur_search_node->next && *(cur_search_node->next->key) <= key) {
-                cur_search_node = cur_search_node->next;
-                ++new_steps;
-            }
+    void skiplist_type::remove(const key_type& key) {
+        insert(key, nullptr);
+    }
 
-            // assign new index
-            cur_base_node = cur_search_node->parent;
+    void skiplist_type::insert(const key_type& key, const char* record) {
+        size_t height = randomHeight();
 
-            // find the corresponding key
-            if (cur_search_node->key && *(cur_search_node->key) == key) {
-                return std::make_pair(cur_base_node, new_steps);
-            }
-            // the key of next node is larger than 'key' or the next node is nullptr
-            else {
-                std::pair<baseDataNode*, size_t> find_pair = find(key, cur_layer - 1, cur_base_node);
-                return std::make_pair(find_pair.first, find_pair.second + new_steps + 1);
-            }
-        }
-        // already the first layer and the key hasn't been found
-        else {
-            return std::make_pair(cur_base_node, new_steps);
+        // a new layer will be added, other writers may raise the height at the same time
+        size_t list_height = cur_height.load(std::memory_order_relaxed);
+        while (height > list_height && !cur_height.compare_exchange_weak(list_height, height, 
+            std::memory_order_relaxed)) {}
+        size_t top_layer = std::max(height, list_height);
+
+        dataNode* prev[max_height];
+        dataNode* succ[max_height];
+        findSplice(key, top_layer, prev, succ);
+
+        // if replace is allowed, replace old value with new value
+        if (succ[0] && succ[0]->key == key) {
+            succ[0]->value.store(record, std::memory_order_release);
+            return;
         }
-    }
 
-    void skiplist_type::put(const key_type& key, const value_type& val) {
-        searchDataNode* new_node = findAndInsert(key, val, head->size(), head);
+        // link the new node from the bottom layer, so readers always see a sorted list
+        dataNode* new_node = newNode(key, height, record);
+        for (size_t i = 0; i < height; ++i) {
+            while (true) {
+                new_node->next_nodes[i].store(succ[i], std::memory_order_relaxed);
+                if (prev[i]->casNext(i, succ[i], new_node)) break;
 
-        // a new layer will be added
-        if (new_node) {
-            searchDataNode* new_head_node = head->addNewSearchNode();
-            new_node->next = new_head_node->next;
-            new_head_node->next = new_node;
+                // another writer has changed this layer, search again from prev[i]
+                findSpliceForLayer(key, i, prev[i], succ[i]);
+
+                // the same key may have been inserted by another writer meanwhile
+                if (!i && succ[0] && succ[0]->key == key) {
+                    succ[0]->value.store(record, std::memory_order_release);
+                    return;
+                }
+            }
         }
+        key_number.fetch_add(1, std::memory_order_relaxed);
     }
 
-    std::optional<value_type> skiplist_type::get(const key_type& key) const {
-        baseDataNode* find_base_node = find(key, head->size(), head).first;
-        searchDataNode* first_search_data_node = find_base_node->getLayer(1);
+    std::optional<entry_type> skiplist_type::get(const key_type& key) const {
+        dataNode* found_node = findGreaterOrEqual(key);
 
         // if find the right node
-        if (first_search_data_node->key && *(first_search_data_node->key) == key) {
-            return find_base_node->getValues();
+        if (found_node && found_node->key == key) {
+            entry_view entry = found_node->getEntry();
+            return entry_type{ entry.kind, value_type(entry.value) };
         }
 
         // return the default value of value_type
@@ -125,24 +162,22 @@ namespace skiplist {
     }
 
     void skiplist_type::clear() {
-        while (head->nextNode()) {
-            baseDataNode* next_node = head->nextNode();
-            head->nextNode() = next_node->nextNode();
-            delete next_node;
-        }
-        delete head;
+        // release all nodes in one shot
+        pool.reset();
         key_number = 0;
 
-        head = new baseDataNode();
-        head->addNewSearchNode();
+        cur_height = 1;
+        head = newNode(key_type{}, max_height, nullptr);
     }
 
     int skiplist_type::query_distance(const key_type& key) const {
-        return find(key, head->size(), head).second + 1;
+        size_t steps = 0;
+        findGreaterOrEqual(key, &steps);
+        return steps + 1;
     }
 
     size_t skiplist_type::size() const {
-        return key_number;
+        return key_number.load(std::memory_order_relaxed);
     }
 
     skiplist_type::const_iterator& skiplist_type::const_iterator::operator++() {
@@ -150,7 +185,7 @@ namespace skiplist {
             throw exception::iterator_null();
         }
 
-        pointer = pointer->nextNode();
+        pointer = pointer->next(0);
         return *this;
     }
 
@@ -160,30 +195,34 @@ namespace skiplist {
         }
 
         skiplist_type::const_iterator old_it = *this;
-        pointer = pointer->nextNode();
+        pointer = pointer->next(0);
         return old_it;
     }
 
-    const value_type& skiplist_type::const_iterator::operator*() const {
-        return this->pointer->getValues();
+    entry_view skiplist_type::const_iterator::operator*() const {
+        return this->pointer->getEntry();
     }
 
-    const value_type& skiplist_type::const_iterator::value() const {
-        return this->pointer->getValues();
+    value_view skiplist_type::const_iterator::value() const {
+        return this->pointer->getEntry().value;
     }
 
 	const key_type& skiplist_type::const_iterator::key() const {
-        return *(this->pointer->getLayer(1)->key);
+        return this->pointer->key;
     }
 
     skiplist_type::const_iterator skiplist_type::cbegin() const {
-        return const_iterator(head->nextNode());
+        return const_iterator(head->next(0));
     }
 
     skiplist_type::const_iterator skiplist_type::cend() const {
         return const_iterator();
     }
 
+    skiplist_type::const_iterator skiplist_type::lower_bound(const key_type& key) const {
+        return const_iterator(findGreaterOrEqual(key));
+    }
+
     bool skiplist_type::const_iterator::operator==(const const_iterator& other) const {
         return this->pointer == other.pointer;
     }
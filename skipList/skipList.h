@@ -1,11 +1,14 @@
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <optional>
-#include <vector>
 #include <string>
+#include <string_view>
+#include "../arena/arena.h"
 #include "../common/definitions.h"
 #include "../common/exceptions.h"
 
@@ -13,89 +16,94 @@ namespace skiplist {
 
 	using key_type = def::key_type;
 	using value_type = def::value_type;
-
-	class baseDataNode;
-
-	// data and search node defined here
-	struct searchDataNode {
-		// this node type is only responsible for searching
-
-		// ATTENTION! for the sake of maximum 
-		key_type* key;
-		size_t layer_number;
-		searchDataNode* next = nullptr;
-		baseDataNode* parent;
-	};
-
-	class baseDataNode {
-	private:
-		// all values saved in on baseDataNode
-		key_type* key;
-		value_type value;
-		baseDataNode* next = nullptr;
-
-		// save all searchDataNode here
-		std::vector<searchDataNode*> nodes;
-
-	public:
-		// ATTENTION! the first construction method is only used to construct head-node
-		baseDataNode() : key(nullptr) {}
-		baseDataNode(const key_type& cur_key) : key(new key_type(cur_key)) {}
-		~baseDataNode() {
-			// delete all nodes
-			for (size_t i = 0; i < nodes.size(); ++i)
-				delete nodes[i];
-
-			// for head-node, key == nullptr
-			if (key) delete key;
+	using value_view = def::value_view;
+	using entry_type = def::entry_type;
+	using entry_view = def::entry_view;
+
+	// the max height of a tower, which is enough for 2^32 keys when p = 0.5
+	const size_t max_height = 32;
+
+	// ATTENTION! a dataNode is allocated together with its tower in one piece of memory
+	// from the arena of skiplist_type, so that the key and the lower forward pointers
+	// share the same cache line, and it is never released individually
+	struct dataNode {
+		key_type key;
+
+		// the value record lives in the arena: a uint32_t length followed by the bytes,
+		// or nullptr for a tombstone, and it is replaced as a whole so that readers never
+		// see a torn value
+		std::atomic<const char*> value;
+		uint32_t height;
+
+		// forward pointers of all layers, the array really has 'height' elements
+		std::atomic<dataNode*> next_nodes[1];
+
+		// readers acquire what writers have released, so no lock is needed
+		dataNode* next(size_t layer) const {
+			// 0-base
+			assert(layer < height);
+			return next_nodes[layer].load(std::memory_order_acquire);
 		}
-
-		baseDataNode*& nextNode() { return this->next; }
-		const value_type& getValues() const { return this->value; }
-		void setValue(const value_type& new_value) { value = new_value; }
-
-		size_t size() const { return nodes.size(); }
-		searchDataNode* getLayer(size_t index) const {
-			// 1-base
-			assert((index - 1) < nodes.size());
-			return nodes[index - 1];
+		void setNext(size_t layer, dataNode* node) {
+			assert(layer < height);
+			next_nodes[layer].store(node, std::memory_order_release);
+		}
+		bool casNext(size_t layer, dataNode* expected, dataNode* node) {
+			assert(layer < height);
+			return next_nodes[layer].compare_exchange_strong(expected, node, 
+				std::memory_order_acq_rel, std::memory_order_acquire);
 		}
 
-		searchDataNode* addNewSearchNode() {
-			searchDataNode* new_node = new searchDataNode();
-			new_node->key = this->key; new_node->layer_number = this->nodes.size();
-			new_node->parent = this;
-			nodes.push_back(new_node);
+		entry_view getEntry() const {
+			return def::recordEntry(value.load(std::memory_order_acquire));
+		}
 
-			// the member 'next' of new_node is set externally
-			return new_node;
+		// the number of bytes a node with a given height occupies
+		static size_t allocationSize(size_t height) {
+			return offsetof(dataNode, next_nodes) + sizeof(std::atomic<dataNode*>) * height;
 		}
 	};
 
+	// ATTENTION! put, remove, get and the iterators may be used by any number of threads
+	// at the same time, while clear must not run concurrently with anything else
 	class skiplist_type
 	{
 	private:
 		// data members of skiplist here
 		double p = 0.5;
-		baseDataNode* head = nullptr;
+		dataNode* head = nullptr;
 
-		size_t key_number = 0;
+		// the number of layers in use
+		std::atomic<size_t> cur_height = 1;
 
-		// method members of skiplist here
-		searchDataNode* findAndInsert(const key_type& key, const value_type& val, 
-			size_t cur_layer, baseDataNode* cur_base_node);
-		std::pair<baseDataNode*, size_t> find(const key_type& key,
-			size_t cur_layer, baseDataNode* cur_base_node) const;
+		std::atomic<size_t> key_number = 0;
 
-		// possibility function
+		// nodes and values are all allocated here
+		arena::bumpArena pool;
+
+		// method members of skiplist here
+		dataNode* newNode(const key_type& key, size_t height, const char* value);
+		const char* newValue(value_view val);
+		void insert(const key_type& key, const char* record);
+		dataNode* findGreaterOrEqual(const key_type& key, size_t* steps = nullptr) const;
+		void findSplice(const key_type& key, size_t top_layer, 
+			dataNode** prev, dataNode** succ) const;
+		void findSpliceForLayer(const key_type& key, size_t layer, 
+			dataNode*& prev, dataNode*& succ) const;
+
+		// possibility function, ATTENTION! each thread has its own random engine
 		bool eventOccur() const;
+		size_t randomHeight() const;
 
 	public:
 		explicit skiplist_type(double p = 0.5);
 		~skiplist_type();
 
-		void put(const key_type& key, const value_type& val);
-		std::optional<value_type> get(const key_type& key) const;
+		void put(const key_type& key, value_view val);
+		std::optional<entry_type> get(const key_type& key) const;
+
+		// a tombstone takes no space for the value
+		void remove(const key_type& key);
 
 		void clear();
 
@@ -103,20 +111,21 @@ namespace skiplist {
 		int query_distance(const key_type& key) const;
 
 		size_t size() const;
+		size_t memoryUsage() const { return pool.memoryUsage(); }
 
 		class const_iterator
 		{
 		private:
-			baseDataNode* pointer = nullptr;
+			const dataNode* pointer = nullptr;
 
 		public:
-			const_iterator(baseDataNode* p = nullptr)
+			const_iterator(const dataNode* p = nullptr)
 				: pointer(p) {}
 			const_iterator& operator++();
 			const_iterator operator++(int);
-			const value_type& operator*() const;
+			entry_view operator*() const;
 
-			const value_type& value() const;
+			value_view value() const;
 			const key_type& key() const;
 
 			bool operator==(const const_iterator& other) const;
@@ -125,6 +134,9 @@ namespace skiplist {
 
 		const_iterator cbegin() const;
 		const_iterator cend() const;
+
+		// the first element whose key is not less than 'key', found with the towers
+		const_iterator lower_bound(const key_type& key) const;
 	};
 
 } // namespace skiplist
@@ -0,0 +1,53 @@
+#include <algorithm>
+#include "cachedKeys.h"
+
+namespace sstable {
+
+    size_t cachedKeys::eytzingerFill(const std::vector<key_type>& sorted_keys,
+        const std::vector<cachedPayload>& sorted_payloads, size_t i, size_t k) {
+        // an in-order walk of the implicit tree takes the keys in order
+        if (k < keys.size()) {
+            i = eytzingerFill(sorted_keys, sorted_payloads, i, 2 * k);
+            keys[k] = sorted_keys[i];
+            payloads[k] = sorted_payloads[i++];
+            i = eytzingerFill(sorted_keys, sorted_payloads, i, 2 * k + 1);
+        }
+        return i;
+    }
+
+    void cachedKeys::build(def::cached_table_layout layout,
+        const std::vector<key_type>& sorted_keys, const std::vector<cachedPayload>& sorted_payloads) {
+        this->layout = layout;
+        keys.clear();
+        payloads.clear();
+        if (layout == def::cached_table_layout::blocks || sorted_keys.empty()) return;
+
+        if (layout == def::cached_table_layout::eytzinger) {
+            keys.resize(sorted_keys.size() + 1);
+            payloads.resize(sorted_keys.size() + 1);
+            eytzingerFill(sorted_keys, sorted_payloads, 0, 1);
+        }
+        else {
+            keys = sorted_keys;
+            payloads = sorted_payloads;
+        }
+    }
+
+    const cachedPayload* cachedKeys::find(const key_type& key) const {
+        if (layout == def::cached_table_layout::eytzinger) {
+            // go down without branches, prefetching the 16 descendants 4 levels below, and
+            // the bits of k are the turns, where the last right turn is the answer's parent
+            size_t n = keys.size(), k = 1;
+            while (k < n) {
+                __builtin_prefetch(keys.data() + std::min(16 * k, n - 1));
+                k = 2 * k + (keys[k] < key);
+            }
+            k >>= __builtin_ffsll(~k);
+            return k && keys[k] == key ? &payloads[k] : nullptr;
+        }
+
+        auto it = std::lower_bound(keys.begin(), keys.end(), key);
+        return it != keys.end() && *it == key ? &payloads[it - keys.begin()] : nullptr;
+    }
+
+}
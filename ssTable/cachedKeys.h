@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../common/definitions.h"
+#include "../common/options.h"
+
+namespace sstable {
+
+    using def::key_type;
+
+    // where the value of a cached key is, and an inline value is at offset in the file
+    struct cachedPayload {
+        uint64_t offset;
+        uint32_t value_length;
+    };
+
+    // the keys of a cached table in one array, with their payloads in a parallel one, so
+    // a lookup only touches keys until it hits, and in Eytzinger order the first levels
+    // of the search share a few cache lines, and the next ones are prefetched
+    class cachedKeys
+    {
+    private:
+        def::cached_table_layout layout = def::cached_table_layout::blocks;
+
+        // in Eytzinger order, the root is at 1 and the children of k are at 2k and 2k + 1
+        std::vector<key_type> keys;
+        std::vector<cachedPayload> payloads;
+
+        size_t eytzingerFill(const std::vector<key_type>& sorted_keys,
+            const std::vector<cachedPayload>& sorted_payloads, size_t i, size_t k);
+
+    public:
+        void build(def::cached_table_layout layout, const std::vector<key_type>& sorted_keys,
+            const std::vector<cachedPayload>& sorted_payloads);
+
+        // nullptr if the key isn't there
+        const cachedPayload* find(const key_type& key) const;
+
+        bool empty() const { return keys.empty(); }
+    };
+
+}
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <cstring>
+#include "packedBlock.h"
+#include "../common/exceptions.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace sstable {
+
+    // a value is read as one uint64_t from its first byte, which holds at most 56 more
+    // bits after the shift, so a wider one takes all 64 bits and needs no shift
+    static uint8_t bitsFor(uint64_t max_value) {
+        uint8_t bits = max_value ? static_cast<uint8_t>(64 - __builtin_clzll(max_value)) : 0;
+        return bits > 56 ? 64 : bits;
+    }
+
+    // the bytes of n values of bits each, rounded up to whole uint64_t
+    static size_t packedSize(size_t n, size_t bits) {
+        return (n * bits + 63) / 64 * sizeof(uint64_t);
+    }
+
+    static uint64_t bitMask(size_t bits) {
+        return bits >= 64 ? UINT64_MAX : (1ull << bits) - 1;
+    }
+
+    static uint64_t unpack(const char* src, size_t bits, size_t i) {
+        size_t bit = i * bits;
+        uint64_t word;
+        memcpy(&word, src + bit / 8, sizeof(word));
+        return (word >> (bit % 8)) & bitMask(bits);
+    }
+
+    static void pack(char* dst, size_t bits, size_t i, uint64_t value) {
+        if (!bits) return;
+        size_t bit = i * bits;
+        uint64_t word;
+        memcpy(&word, dst + bit / 8, sizeof(word));
+        word |= value << (bit % 8);
+        memcpy(dst + bit / 8, &word, sizeof(word));
+    }
+
+    // an inline value is told apart by the lowest bit of the stored length, so an empty
+    // one isn't a tombstone
+    static uint32_t storedLength(const ssTableData& dat) {
+        return (def::valueLength(dat) << 1) | (def::isInlineValue(dat) ? 1 : 0);
+    }
+
+    static const size_t packed_padding_size = sizeof(uint64_t);
+
+    // the data of a block from the stored parts of one entry
+    static ssTableData storedEntry(const packedBlockHeader& header, uint64_t key_delta,
+        uint64_t stored_offset, uint64_t stored_length) {
+        ssTableData dat{};
+        dat.key = header.base_key + key_delta;
+        dat.value_length = static_cast<uint32_t>(stored_length >> 1) |
+            (stored_length & 1 ? def::inline_value_flag : 0);
+        dat.offset = stored_offset;
+        if (!def::isInlineValue(dat) && !def::isTombstone(dat)) dat.offset += header.base_offset;
+        return dat;
+    }
+
+#if defined(__x86_64__)
+    // unpack 4 values of an array at once from the uint64_t each starts in, which are
+    // loaded one by one since gathers are slower than that on most CPUs
+    __attribute__((target("avx2")))
+    static __m256i unpack4(const char* src, size_t bits, size_t i) {
+        size_t bit = i * bits;
+        uint64_t words[4];
+        for (size_t lane = 0; lane < 4; ++lane, bit += bits) {
+            memcpy(&words[lane], src + bit / 8, sizeof(uint64_t));
+        }
+        __m256i shifts = _mm256_add_epi64(_mm256_set1_epi64x((i * bits) % 8),
+            _mm256_mul_epu32(_mm256_setr_epi64x(0, 1, 2, 3), _mm256_set1_epi64x(bits)));
+        __m256i result = _mm256_loadu_si256((const __m256i*)words);
+        result = _mm256_srlv_epi64(result, _mm256_sub_epi64(shifts, 
+            _mm256_slli_epi64(_mm256_srli_epi64(shifts, 3), 3)));
+        return _mm256_and_si256(result, _mm256_set1_epi64x(bitMask(bits)));
+    }
+
+    // unpack the entries 4 at a time, where the keys, the lengths and the offsets are
+    // restored in the lanes, and return how many are done
+    __attribute__((target("avx2")))
+    static size_t decodeAvx2(const packedBlockHeader& header, const char* keys,
+        const char* offsets, const char* lengths, ssTableData* dst) {
+        size_t number = header.key_value_pair_number, i = 0;
+        const __m256i base_key = _mm256_set1_epi64x(header.base_key);
+        const __m256i base_offset = _mm256_set1_epi64x(header.base_offset);
+        const __m256i one = _mm256_set1_epi64x(1), zero = _mm256_setzero_si256();
+        const __m256i inline_flag = _mm256_set1_epi64x(def::inline_value_flag);
+        for (; i + 4 <= number; i += 4) {
+            __m256i key = _mm256_add_epi64(unpack4(keys, header.key_bits, i), base_key);
+            __m256i stored_length = unpack4(lengths, header.length_bits, i);
+            __m256i offset = unpack4(offsets, header.offset_bits, i);
+
+            // the lowest bit of a stored length marks an inline value, and an offset in
+            // vLog is over the base unless it's a tombstone
+            __m256i is_inline = _mm256_cmpeq_epi64(_mm256_and_si256(stored_length, one), one);
+            __m256i length = _mm256_or_si256(_mm256_srli_epi64(stored_length, 1),
+                _mm256_and_si256(is_inline, inline_flag));
+            __m256i in_v_log = _mm256_andnot_si256(_mm256_or_si256(is_inline,
+                _mm256_cmpeq_epi64(stored_length, zero)), _mm256_set1_epi64x(-1));
+            offset = _mm256_add_epi64(offset, _mm256_and_si256(in_v_log, base_offset));
+
+            uint64_t key_lanes[4], offset_lanes[4], length_lanes[4];
+            _mm256_storeu_si256((__m256i*)key_lanes, key);
+            _mm256_storeu_si256((__m256i*)offset_lanes, offset);
+            _mm256_storeu_si256((__m256i*)length_lanes, length);
+            for (size_t lane = 0; lane < 4; ++lane) {
+                ssTableData& dat = dst[i + lane];
+                dat.key = key_lanes[lane];
+                dat.offset = offset_lanes[lane];
+                dat.value_length = static_cast<uint32_t>(length_lanes[lane]);
+            }
+        }
+        return i;
+    }
+#endif
+
+    bool packedBlockReader::simdDecode() {
+#if defined(__x86_64__)
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    size_t packedBlockBuilder::encodedSize(size_t number, key_type max_key, uint64_t max_offset,
+        uint32_t max_stored_length) const {
+        key_type base_key = block_data.empty() ? max_key : block_data.front().key;
+        return sizeof(packedBlockHeader) + packedSize(number, bitsFor(max_key - base_key)) +
+            packedSize(number, bitsFor(max_offset)) + packedSize(number, bitsFor(max_stored_length)) +
+            packed_padding_size;
+    }
+
+    uint64_t packedBlockBuilder::maxStoredOffset(uint64_t min_v_log, uint64_t max_v_log,
+        uint64_t max_inline) const {
+        return std::max(min_v_log <= max_v_log ? max_v_log - min_v_log : 0, max_inline);
+    }
+
+    size_t packedBlockBuilder::sizeWith(const ssTableData& dat) const {
+        uint64_t min_v_log = min_v_log_offset, max_v_log = max_v_log_offset;
+        uint64_t max_inline = max_inline_offset;
+        if (def::isInlineValue(dat)) {
+            max_inline = std::max(max_inline, dat.offset);
+        }
+        else if (!def::isTombstone(dat)) {
+            min_v_log = std::min(min_v_log, dat.offset);
+            max_v_log = std::max(max_v_log, dat.offset);
+        }
+        return encodedSize(block_data.size() + 1, dat.key,
+            maxStoredOffset(min_v_log, max_v_log, max_inline),
+            std::max(max_length, storedLength(dat)));
+    }
+
+    void packedBlockBuilder::add(const ssTableData& dat) {
+        // keys are added in order
+        if (def::isInlineValue(dat)) {
+            max_inline_offset = std::max(max_inline_offset, dat.offset);
+        }
+        else if (!def::isTombstone(dat)) {
+            min_v_log_offset = std::min(min_v_log_offset, dat.offset);
+            max_v_log_offset = std::max(max_v_log_offset, dat.offset);
+        }
+        max_length = std::max(max_length, storedLength(dat));
+        block_data.push_back(dat);
+    }
+
+    void packedBlockBuilder::finish(std::string& dst) {
+        size_t number = block_data.size();
+        packedBlockHeader header{};
+        header.base_key = block_data.front().key;
+        header.base_offset = min_v_log_offset <= max_v_log_offset ? min_v_log_offset : 0;
+        header.key_value_pair_number = static_cast<uint32_t>(number);
+        header.key_bits = bitsFor(block_data.back().key - header.base_key);
+        header.offset_bits = bitsFor(
+            maxStoredOffset(min_v_log_offset, max_v_log_offset, max_inline_offset));
+        header.length_bits = bitsFor(max_length);
+
+        // the arrays are packed into zeroed bytes
+        size_t start = dst.size();
+        size_t key_size = packedSize(number, header.key_bits);
+        size_t offset_size = packedSize(number, header.offset_bits);
+        size_t length_size = packedSize(number, header.length_bits);
+        dst.resize(start + sizeof(header) + key_size + offset_size + length_size +
+            packed_padding_size, '\0');
+        memcpy(&dst[start], &header, sizeof(header));
+        char* keys = &dst[start + sizeof(header)];
+        char* offsets = keys + key_size;
+        char* lengths = offsets + offset_size;
+        for (size_t i = 0; i < number; ++i) {
+            const ssTableData& dat = block_data[i];
+            pack(keys, header.key_bits, i, dat.key - header.base_key);
+            uint64_t offset = 0;
+            if (def::isInlineValue(dat)) offset = dat.offset;
+            else if (!def::isTombstone(dat)) offset = dat.offset - header.base_offset;
+            pack(offsets, header.offset_bits, i, offset);
+            pack(lengths, header.length_bits, i, storedLength(dat));
+        }
+
+        // reset the state
+        block_data.clear();
+        min_v_log_offset = UINT64_MAX;
+        max_v_log_offset = max_inline_offset = 0;
+        max_length = 0;
+    }
+
+    packedBlockReader::packedBlockReader(const char* src, size_t size) : src(src) {
+        if (size < sizeof(header)) throw exception::sstable_io_error();
+        memcpy(&header, src, sizeof(header));
+        if (header.key_bits > 64 || header.offset_bits > 64 || header.length_bits > 32) {
+            throw exception::sstable_io_error();
+        }
+
+        size_t number = header.key_value_pair_number;
+        keys = src + sizeof(header);
+        offsets = keys + packedSize(number, header.key_bits);
+        lengths = offsets + packedSize(number, header.offset_bits);
+        encoded_size = lengths + packedSize(number, header.length_bits) +
+            packed_padding_size - src;
+        if (encoded_size > size) throw exception::sstable_io_error();
+    }
+
+    key_type packedBlockReader::key(size_t i) const {
+        return header.base_key + unpack(keys, header.key_bits, i);
+    }
+
+    ssTableData packedBlockReader::entry(size_t i) const {
+        return storedEntry(header, unpack(keys, header.key_bits, i),
+            unpack(offsets, header.offset_bits, i), unpack(lengths, header.length_bits, i));
+    }
+
+    size_t packedBlockReader::lowerBound(const key_type& key) const {
+        // search among the packed keys, which are over the first one
+        if (key <= header.base_key) return 0;
+        uint64_t delta = key - header.base_key;
+        size_t low = 0, high = header.key_value_pair_number;
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (unpack(keys, header.key_bits, mid) < delta) low = mid + 1;
+            else high = mid;
+        }
+        return low;
+    }
+
+    void packedBlockReader::decode(std::vector<ssTableData>& dst) const {
+        size_t number = header.key_value_pair_number, i = 0;
+        dst.resize(number);
+
+#if defined(__x86_64__)
+        if (simdDecode()) i = decodeAvx2(header, keys, offsets, lengths, dst.data());
+#endif
+
+        for (; i < number; ++i) dst[i] = entry(i);
+    }
+
+}
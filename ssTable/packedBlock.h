@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../common/definitions.h"
+
+namespace sstable {
+
+    using def::key_type;
+    using def::ssTableData;
+
+    // a data block whose keys, offsets and lengths are each bit-packed over a base of the
+    // block (frame of reference), so any of them is read alone for a binary search, and
+    // the whole block is unpacked with the same shifts and masks, 4 lanes at once with AVX2
+    // where the CPU has it
+    //
+    // the block is the header, the keys over base_key, the offsets and the lengths, each
+    // of which starts at a multiple of 8 bytes, and 8 bytes of padding after them so a
+    // value is always read as one unaligned uint64_t, followed by the inline values
+    struct packedBlockHeader {
+        key_type base_key;
+        uint64_t base_offset;
+        uint32_t key_value_pair_number;
+        uint8_t key_bits, offset_bits, length_bits, reserved;
+    };
+
+    // collects the data of a block and packs them with the fewest bits, where the offset
+    // of an inline value is relative to the inline values of the block and is stored as
+    // is, while an offset in vLog is stored over the least one in the block
+    class packedBlockBuilder
+    {
+    private:
+        std::vector<ssTableData> block_data;
+        uint64_t min_v_log_offset = UINT64_MAX, max_v_log_offset = 0;
+        uint64_t max_inline_offset = 0;
+        uint32_t max_length = 0;
+
+        size_t encodedSize(size_t number, key_type max_key, uint64_t max_offset,
+            uint32_t max_stored_length) const;
+        uint64_t maxStoredOffset(uint64_t min_v_log, uint64_t max_v_log, uint64_t max_inline) const;
+
+    public:
+        // the bytes of the block without its inline values if the data were added
+        size_t sizeWith(const ssTableData& dat) const;
+
+        void add(const ssTableData& dat);
+        bool empty() const { return block_data.empty(); }
+        size_t size() const { return block_data.size(); }
+
+        // appends the packed block to dst and starts a new one
+        void finish(std::string& dst);
+    };
+
+    // reads a packed block in place
+    class packedBlockReader
+    {
+    private:
+        const char* src;
+        packedBlockHeader header{};
+        const char* keys = nullptr, * offsets = nullptr, * lengths = nullptr;
+        size_t encoded_size = 0;
+
+    public:
+        // ATTENTION! throws sstable_io_error if the block is larger than size
+        packedBlockReader(const char* src, size_t size);
+
+        size_t size() const { return header.key_value_pair_number; }
+        key_type key(size_t i) const;
+        ssTableData entry(size_t i) const;
+
+        // the first one whose key isn't less than the key
+        size_t lowerBound(const key_type& key) const;
+
+        // unpack all data of the block, with AVX2 if the CPU has it
+        void decode(std::vector<ssTableData>& dst) const;
+        static bool simdDecode();
+
+        // the bytes before the inline values
+        size_t encodedSize() const { return encoded_size; }
+    };
+
+}
@@ -1,15 +1,96 @@
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
+#include <cstring>
+#include <fcntl.h>
 #include <filesystem>
+#include <fstream>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "ssTable.h"
 #include "../utils.h"
+#include "../compression/compression.h"
 #include "../common/exceptions.h"
 #include "../common/definitions.h"
 
 namespace sstable {
 
+    static def::filter_type filterType(const def::ssTableHeader& header) {
+        return static_cast<def::filter_type>(header.flags & def::sstable_filter_mask);
+    }
+
+    static size_t alignedOffset(size_t offset) {
+        return (offset + alignof(ssTableData) - 1) / alignof(ssTableData) * alignof(ssTableData);
+    }
+
+    void buildFilter(ssTableContent* content, double bits_per_key) {
+        size_t number = content->header.key_value_pair_number;
+        content->header.flags |= def::sstable_sized_filter_flag;
+
+        // m bits and k = m / n * ln2 hashes give the least false positive rate
+        bits_per_key = std::clamp(bits_per_key, 1.0, (double)def::max_filter_bits_per_key);
+        size_t byte_count = std::max<size_t>((size_t)(number * bits_per_key + 7) / 8, 1);
+        size_t hashes = std::max<size_t>((size_t)std::lround(bits_per_key * M_LN2), 1);
+
+        switch (filterType(content->header)) {
+            case def::filter_type::xor_filter: {
+                // the fingerprint of f bits has the false positive rate of a bloom filter
+                // with f / ln2 bits for each key, in 1.23 * f bits
+                size_t fingerprint_bits = std::clamp<size_t>(hashes, 1, 16);
+                std::vector<key_type> keys(number);
+                for (size_t i = 0; i < number; ++i) keys[i] = content->data[i].key;
+                xorFilter filter(xorFilter::bytesFor(number, fingerprint_bits), fingerprint_bits);
+                if (filter.build(keys)) {
+                    content->filter_content.assign((const char*)filter.getContent(), filter.size());
+                    content->filter_hashes = static_cast<uint32_t>(fingerprint_bits);
+                    return;
+                }
+
+                // keys which can't be peeled are left to a blocked bloom filter
+                content->header.flags = (content->header.flags & ~def::sstable_filter_mask) |
+                    static_cast<uint32_t>(def::filter_type::blocked_bloom);
+                [[fallthrough]];
+            }
+            case def::filter_type::blocked_bloom: {
+                // the filter is made of whole blocks, and a key sets a bit in every word of
+                // its block whatever the bits for each key are
+                blockedBloomFilter filter(byte_count);
+                hashes = blockedBloomFilter::maxHashes();
+                for (size_t i = 0; i < number; ++i) filter.insert(content->data[i].key);
+                content->filter_content.assign((const char*)filter.getContent(), filter.size());
+                break;
+            }
+            case def::filter_type::bloom:
+            default: {
+                bloomFilter filter(byte_count, hashes);
+                for (size_t i = 0; i < number; ++i) filter.insert(content->data[i].key);
+                content->filter_content.assign((const char*)filter.getContent(), byte_count);
+                break;
+            }
+        }
+        content->filter_hashes = static_cast<uint32_t>(hashes);
+    }
+
+    void buildRangeFilter(ssTableContent* content, double bits_per_key) {
+        size_t number = content->header.key_value_pair_number;
+        content->header.flags |= def::sstable_range_filter_flag;
+
+        bits_per_key = std::clamp(bits_per_key, 1.0, (double)def::max_filter_bits_per_key);
+        size_t byte_count = std::max<size_t>((size_t)(number * bits_per_key + 7) / 8, 1);
+        size_t hashes = blockedBloomFilter::maxHashes();
+        size_t shift = rangeFilter::shiftFor(content->header.min_key, 
+            content->header.max_key, number);
+
+        rangeFilter filter(byte_count, hashes, shift);
+        for (size_t i = 0; i < number; ++i) filter.insert(content->data[i].key);
+        content->range_filter_content.assign((const char*)filter.getContent(), filter.size());
+        content->range_filter_hashes = static_cast<uint32_t>(hashes);
+        content->range_filter_shift = static_cast<uint32_t>(shift);
+    }
+
     SSTable::SSTable(const std::string& dir_name, uint64_t ts, size_t layer, 
         const std::string& name) : timestamp(ts) {
         // use a safer way to join directories
@@ -21,136 +102,554 @@ namespace sstable {
             throw exception::create_directory_fail();
         }
 
-        // a safer way to use directory
+        // a safer way to use directory, and the file is created when it's written
         directory.append(name);
         directory.replace_extension(def::sstable_extension_name);
         file_name = directory.string();
-
-        // open file
-        file_stream.open(file_name, std::ios::in | std::ios::out | std::ios::binary);
-        if (!file_stream.is_open()) {
-            file_stream.clear();
-            file_stream.open(file_name, std::ios::out);
-            file_stream.close();
-            file_stream.open(file_name, std::ios::in | std::ios::out | std::ios::binary);
-        }
     }
 
-    SSTable::SSTable(const std::string& file_name) {
-        // open file
-        file_stream.open(file_name, std::ios::in | std::ios::binary);
-        assert(file_stream.is_open());
-
+    SSTable::SSTable(const std::string& file_name) : file_name(file_name) {
         // initialization for SSTable
         initialize();
     }
 
+    SSTable::SSTable(const std::string& file_name, const def::ssTableHeader& header) : 
+        file_name(file_name), timestamp(header.time), header(header), has_header(true) {}
+
+    def::ssTableHeader readHeader(const std::string& file_name) {
+        int fd = ::open(file_name.c_str(), O_RDONLY);
+        if (fd < 0) {
+            perror("open");
+            throw exception::sstable_io_error();
+        }
+        def::ssTableHeader header;
+        ssize_t length = pread(fd, &header, def::sstable_header_size, 0);
+        close(fd);
+        if (length != (ssize_t)def::sstable_header_size) throw exception::sstable_io_error();
+        return header;
+    }
+
     SSTable::~SSTable() {
-        // close the file and write into it
-        file_stream.close();
-        if (content) delete content;
-        if (filter) delete filter;
+        unmap();
     }
 
     void SSTable::initialize() {
-        // load ssTableContent from file system
-        load();
-        timestamp = content->header.time;
+        // map the file
+        open();
     }
 
-    void SSTable::write(ssTableContent* content_to_write) {
+    void SSTable::open() {
+        std::call_once(open_flag, [this]() {
+            load();
+            buildCachedKeys();
+        });
+    }
+
+    void SSTable::write(ssTableContent* content_to_write, size_t block_size, 
+        def::compression_type compression) {
         // no existing content allowed
-        assert(!content);
+        assert(!mapping);
+
+        // the data is written in blocks, which start at offsets aligned for ssTableData
+        content_to_write->header.flags |= def::sstable_block_format_flag;
+        bool compressed = compression != def::compression_type::none && 
+            compression::available(compression);
+        if (compressed) content_to_write->header.flags |= def::sstable_compressed_block_flag;
 
-        // directly write int file
-        file_stream.seekp(0, std::ios::beg);
-        file_stream.write((char*)content_to_write, def::sstable_header_size + def::bloom_filter_size
-		    + def::sstable_data_size * content_to_write->header.key_value_pair_number);
+        // directly write int file the header, the filter, the data blocks, the index and
+        // the footer
+        std::ofstream file_stream(file_name, std::ios::out | std::ios::trunc | std::ios::binary);
+        auto pad = [&file_stream]() {
+            size_t padding = alignedOffset((size_t)file_stream.tellp()) - (size_t)file_stream.tellp();
+            file_stream.write(std::string(padding, '\0').data(), padding);
+        };
+        file_stream.write((char*)&content_to_write->header, def::sstable_header_size);
+        if (content_to_write->header.flags & def::sstable_sized_filter_flag) {
+            uint32_t filter_size = static_cast<uint32_t>(content_to_write->filter_content.size());
+            file_stream.write((char*)&filter_size, sizeof(filter_size));
+            file_stream.write((char*)&content_to_write->filter_hashes, 
+                sizeof(content_to_write->filter_hashes));
+        }
+        file_stream.write(content_to_write->filter_content.data(), 
+            content_to_write->filter_content.size());
+        if (content_to_write->header.flags & def::sstable_range_filter_flag) {
+            uint32_t range_filter_size = 
+                static_cast<uint32_t>(content_to_write->range_filter_content.size());
+            file_stream.write((char*)&range_filter_size, sizeof(range_filter_size));
+            file_stream.write((char*)&content_to_write->range_filter_hashes, 
+                sizeof(content_to_write->range_filter_hashes));
+            file_stream.write((char*)&content_to_write->range_filter_shift, 
+                sizeof(content_to_write->range_filter_shift));
+            file_stream.write(content_to_write->range_filter_content.data(), range_filter_size);
+        }
+        pad();
+
+        // a block takes pairs until the next one would make it larger than block_size,
+        // and the offsets of its inline values are relative to its own ones
+        bool packed = content_to_write->header.flags & def::sstable_packed_block_flag;
+        std::vector<def::ssTableBlockHandle> block_handles;
+        std::vector<ssTableData> block_data;
+        packedBlockBuilder packed_builder;
+        std::string block_bytes, block_inline_values, compressed_bytes;
+        auto write_block = [&]() {
+            if (packed) {
+                packed_builder.finish(block_bytes);
+            }
+            else {
+                block_bytes.assign((const char*)block_data.data(), 
+                    block_data.size() * def::sstable_data_size);
+            }
+            block_bytes.append(block_inline_values);
+
+            def::ssTableBlockHandle& handle = block_handles.emplace_back();
+            handle.first_key = block_data.front().key;
+            handle.offset = (uint64_t)file_stream.tellp();
+            handle.key_value_pair_number = static_cast<uint32_t>(block_data.size());
 
-        // assign content
-        this->content = content_to_write;
+            // the whole block is compressed, and kept as it is if it hardly shrinks
+            if (compressed) {
+                def::blockCompressionHeader block_header{};
+                block_header.raw_size = static_cast<uint32_t>(block_bytes.size());
+                if (compression::compress(compression, block_bytes, compressed_bytes)) {
+                    block_header.compression = static_cast<uint8_t>(compression);
+                    block_bytes.swap(compressed_bytes);
+                }
+                file_stream.write((char*)&block_header, sizeof(block_header));
+            }
+            handle.size = static_cast<uint32_t>((uint64_t)file_stream.tellp() - handle.offset + 
+                block_bytes.size());
+            file_stream.write(block_bytes.data(), block_bytes.size());
+            pad();
+
+            block_data.clear();
+            block_bytes.clear();
+            block_inline_values.clear();
+        };
+        for (const ssTableData& dat : content_to_write->data) {
+            ssTableData block_dat = dat;
+            size_t value_size = 0;
+            if (def::isInlineValue(dat)) {
+                block_dat.offset = block_inline_values.size();
+                value_size = def::valueLength(dat);
+            }
+            size_t encoded_size = packed ? packed_builder.sizeWith(block_dat) : 
+                (block_data.size() + 1) * def::sstable_data_size;
+            if (!block_data.empty() && 
+                encoded_size + block_inline_values.size() + value_size > block_size) {
+                write_block();
+                if (def::isInlineValue(dat)) block_dat.offset = 0;
+            }
+
+            if (def::isInlineValue(dat)) {
+                block_inline_values.append(content_to_write->inlineValue(dat));
+            }
+            block_data.push_back(block_dat);
+            if (packed) packed_builder.add(block_dat);
+        }
+        if (!block_data.empty()) write_block();
+
+        // the model is built over the same first keys the index is searched by
+        learnedIndex model(def::learned_index_error);
+        if (content_to_write->header.flags & def::sstable_learned_index_flag) {
+            model.build([&block_handles](size_t i) { return block_handles[i].first_key; }, 
+                block_handles.size());
+        }
+
+        def::ssTableFooter footer{};
+        footer.index_offset = (uint64_t)file_stream.tellp();
+        footer.block_number = static_cast<uint32_t>(block_handles.size());
+        footer.segment_number = static_cast<uint32_t>(model.size());
+        footer.magic = def::sstable_footer_magic;
+        file_stream.write((char*)block_handles.data(), 
+            block_handles.size() * sizeof(def::ssTableBlockHandle));
+        file_stream.write((char*)model.getSegments(), model.size() * sizeof(linearSegment));
+        file_stream.write((char*)&footer, def::sstable_footer_size);
+
+        // the bytes must be in the file before it's mapped, and synced by the caller before
+        // the log of the table is removed
+        file_stream.close();
+        if (file_stream.fail()) throw exception::sstable_io_error();
 
         // TODO: actually I hope read could be separate from write
-        // filter initialized here
-        filter = new bloomFilter(def::bloom_filter_size);
-        filter->set(content->bloomFilterContent);
+        // the table is read from the file like any other one since then
+        delete content_to_write;
+        open();
+    }
+
+    static bool sameHeader(const def::ssTableHeader& a, const def::ssTableHeader& b) {
+        return a.time == b.time && a.key_value_pair_number == b.key_value_pair_number && 
+            a.flags == b.flags && a.min_key == b.min_key && a.max_key == b.max_key;
+    }
+
+    // whether the words of a blocked bloom filter may be read in place
+    static bool viewableBlocks(const char* src, size_t byte_count) {
+        return byte_count && byte_count % blockedBloomFilter::blockSize() == 0 && 
+            (uintptr_t)src % alignof(uint64_t) == 0;
+    }
+
+    void SSTable::createFilter(const char* src, size_t byte_count, uint32_t hashes) {
+        const unsigned char* filter_src = (const unsigned char*)src;
+
+        // the filters are read in place in the mapping, which lives as long as the table
+        switch (filterType(header)) {
+            case def::filter_type::xor_filter: {
+                filter = std::make_unique<xorFilter>(filter_src, byte_count, hashes);
+                break;
+            }
+            case def::filter_type::blocked_bloom: {
+                if (viewableBlocks(src, byte_count)) {
+                    filter = std::make_unique<blockedBloomFilter>(filter_src, byte_count, hashes);
+                    break;
+                }
+                auto blocked_filter = std::make_unique<blockedBloomFilter>(byte_count, hashes);
+                blocked_filter->set(filter_src);
+                filter = std::move(blocked_filter);
+                break;
+            }
+            case def::filter_type::bloom:
+            default: {
+                filter = std::make_unique<bloomFilter>(filter_src, byte_count, hashes);
+                break;
+            }
+        }
+    }
+
+    void SSTable::ownFilters() {
+        if (filter) filter->own();
+        if (range_filter) range_filter->own();
     }
 
     void SSTable::load() {
-        // no existing content allowed
-        if (content) return;
-        content = new ssTableContent;
-        filter = new bloomFilter(def::bloom_filter_size);
+        // no existing mapping allowed
+        if (mapping) return;
 
-        // directly read from file
-        file_stream.seekg(0, std::ios::beg);
-        file_stream.read((char*)content, sizeof(ssTableContent));
+        int fd = ::open(file_name.c_str(), O_RDONLY);
+        if (fd < 0) {
+            perror("open");
+            throw exception::sstable_io_error();
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < def::sstable_header_size) {
+            close(fd);
+            throw exception::sstable_io_error();
+        }
 
-        // set bloomFilter
-        filter->set(content->bloomFilterContent);
+        // the mapping stays valid after the file is closed, or even removed
+        mapping_size = st.st_size;
+        void* address = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED) {
+            perror("mmap");
+            throw exception::sstable_io_error();
+        }
+        mapping = (const char*)address;
+
+        // a lookup only needs a few pages, so reading ahead is a waste
+        madvise(address, mapping_size, MADV_RANDOM);
+
+        // a lambda function to take the next bytes of the file
+        size_t pos = 0;
+        auto take = [&](size_t length) -> const char* {
+            if (pos + length > mapping_size) {
+                unmap();
+                throw exception::sstable_io_error();
+            }
+            pos += length;
+            return mapping + pos - length;
+        };
+        def::ssTableHeader file_header;
+        memcpy(&file_header, take(def::sstable_header_size), def::sstable_header_size);
+        if (!has_header) {
+            header = file_header;
+            timestamp = header.time;
+            has_header = true;
+        }
+        else if (!sameHeader(file_header, header)) {
+            unmap();
+            throw exception::sstable_io_error();
+        }
+
+        // tables written before filters are sized have a fixed bloom filter
+        uint32_t filter_size = def::bloom_filter_size;
+        uint32_t filter_hashes = def::legacy_filter_hashes;
+        if (header.flags & def::sstable_sized_filter_flag) {
+            memcpy(&filter_size, take(sizeof(filter_size)), sizeof(filter_size));
+            memcpy(&filter_hashes, take(sizeof(filter_hashes)), sizeof(filter_hashes));
+        }
+        createFilter(take(filter_size), filter_size, filter_hashes);
+
+        if (header.flags & def::sstable_range_filter_flag) {
+            uint32_t range_filter_size, range_filter_hashes, range_filter_shift;
+            memcpy(&range_filter_size, take(sizeof(uint32_t)), sizeof(uint32_t));
+            memcpy(&range_filter_hashes, take(sizeof(uint32_t)), sizeof(uint32_t));
+            memcpy(&range_filter_shift, take(sizeof(uint32_t)), sizeof(uint32_t));
+            const char* range_filter_src = take(range_filter_size);
+            if (viewableBlocks(range_filter_src, range_filter_size)) {
+                range_filter = std::make_unique<rangeFilter>(
+                    (const unsigned char*)range_filter_src, range_filter_size, 
+                    range_filter_hashes, range_filter_shift);
+            }
+            else {
+                range_filter = std::make_unique<rangeFilter>(range_filter_size, 
+                    range_filter_hashes, range_filter_shift);
+                range_filter->set((const unsigned char*)range_filter_src);
+            }
+        }
+        if (cached) ownFilters();
+
+        // a block-based table finds its index from the footer at the end
+        if (header.flags & def::sstable_block_format_flag) {
+            def::ssTableFooter footer;
+            if (mapping_size < pos + def::sstable_footer_size) take(def::sstable_footer_size);
+            memcpy(&footer, mapping + mapping_size - def::sstable_footer_size, 
+                def::sstable_footer_size);
+            size_t index_size = footer.block_number * sizeof(def::ssTableBlockHandle);
+            size_t model_size = footer.segment_number * sizeof(linearSegment);
+            if (footer.magic != def::sstable_footer_magic || footer.index_offset < pos || 
+                footer.index_offset % alignof(def::ssTableBlockHandle) || 
+                footer.index_offset + index_size + model_size + def::sstable_footer_size != 
+                mapping_size) {
+                unmap();
+                throw exception::sstable_io_error();
+            }
+            index = (const def::ssTableBlockHandle*)(mapping + footer.index_offset);
+            block_number = footer.block_number;
+            block_model.set((const linearSegment*)(mapping + footer.index_offset + index_size), 
+                footer.segment_number);
+            return;
+        }
+
+        // the older table is one block of all its data followed by all its inline values,
+        // and the data is read in place if it's aligned, and copied otherwise
+        if (header.flags & def::sstable_aligned_data_flag) take(alignedOffset(pos) - pos);
+        size_t data_size = def::sstable_data_size * header.key_value_pair_number;
+        const char* data_src = take(data_size);
+        if ((uintptr_t)data_src % alignof(ssTableData)) {
+            unaligned_data.resize(header.key_value_pair_number);
+            memcpy(unaligned_data.data(), data_src, data_size);
+        }
+        whole_table_block.first_key = header.min_key;
+        whole_table_block.offset = data_src - mapping;
+        whole_table_block.size = static_cast<uint32_t>(mapping_size - whole_table_block.offset);
+        whole_table_block.key_value_pair_number = header.key_value_pair_number;
+        index = &whole_table_block;
+        block_number = 1;
     }
 
-    void SSTable::flush() {
-        file_stream.flush();
+    void SSTable::unmap() {
+        if (mapping) munmap((void*)mapping, mapping_size);
+        mapping = nullptr;
+        mapping_size = 0;
     }
 
-    // return offset of the key-value pair in vLog
-    std::optional<std::pair<uint64_t, u_int32_t>> SSTable::get(const key_type& key) {
-        // content shouldn't be equal to nullptr
-        assert(content);
+    void SSTable::adviseSequential() {
+        open();
+        if (mapping) madvise((void*)mapping, mapping_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+    }
+
+    size_t SSTable::findBlock(const key_type& key) const {
+        // the model narrows the search of the index to a few blocks, and without segments
+        // the whole index is searched
+        auto first_key_at = [this](size_t i) { return index[i].first_key; };
+        size_t i = block_model.lowerBound(first_key_at, block_number, key);
+        if (i < block_number && index[i].first_key == key) return i;
+        return i ? i - 1 : 0;
+    }
+
+    std::string_view SSTable::blockContent(size_t block_index, std::string& buffer) const {
+        // the handle is checked before the block is read
+        assert(block_index < block_number);
+        const def::ssTableBlockHandle& handle = index[block_index];
+        if (handle.offset + handle.size > mapping_size) throw exception::sstable_io_error();
+        std::string_view block(mapping + handle.offset, handle.size);
+        if (!(header.flags & def::sstable_compressed_block_flag)) return block;
+
+        // the bytes after the header are the block itself unless they're compressed
+        def::blockCompressionHeader block_header;
+        if (block.size() < sizeof(block_header)) throw exception::sstable_io_error();
+        memcpy(&block_header, block.data(), sizeof(block_header));
+        block.remove_prefix(sizeof(block_header));
+        auto compression = static_cast<def::compression_type>(block_header.compression);
+        if (compression == def::compression_type::none) return block;
+        try {
+            compression::decompress(compression, block, buffer, block_header.raw_size);
+        }
+        catch (const exception::compression_error&) {
+            throw exception::sstable_io_error();
+        }
+        return buffer;
+    }
+
+    void SSTable::readBlock(size_t block_index, blockView& view) const {
+        const def::ssTableBlockHandle& handle = index[block_index];
+        std::string_view block = blockContent(block_index, view.decompressed_block);
+        const char* src = block.data();
+        size_t data_size = def::sstable_data_size * handle.key_value_pair_number;
 
-        // min_key and max_key check
-        if (key < content->header.min_key || key > content->header.max_key) {
+        // a packed block is unpacked into the view
+        if (header.flags & def::sstable_packed_block_flag) {
+            packedBlockReader reader(src, block.size());
+            reader.decode(view.decoded_data);
+            view.data = view.decoded_data.data();
+            data_size = reader.encodedSize();
+        }
+        else {
+            if (data_size > block.size()) throw exception::sstable_io_error();
+            view.data = unaligned_data.empty() ? (const ssTableData*)src : unaligned_data.data();
+            if ((uintptr_t)view.data % alignof(ssTableData)) throw exception::sstable_io_error();
+        }
+        view.key_value_pair_number = handle.key_value_pair_number;
+        view.inline_values = block.substr(data_size);
+    }
+
+    void SSTable::cacheKeys(def::cached_table_layout layout, size_t max_keys) {
+        // an opened table builds them at once, and the others when they're opened
+        cached = true;
+        cached_layout = layout;
+        max_cached_keys = max_keys;
+        if (mapping) {
+            ownFilters();
+            buildCachedKeys();
+        }
+    }
+
+    void SSTable::buildCachedKeys() {
+        if (cached_layout == def::cached_table_layout::blocks || 
+            header.key_value_pair_number > max_cached_keys) return;
+
+        // the inline values of compressed blocks aren't in the file as they are
+        if (header.flags & def::sstable_compressed_block_flag) return;
+
+        // an inline value is found by its offset in the file since then
+        std::vector<key_type> keys;
+        std::vector<cachedPayload> payloads;
+        keys.reserve(header.key_value_pair_number);
+        payloads.reserve(header.key_value_pair_number);
+        for (ssTableCursor cursor(this); cursor.valid(); cursor.next()) {
+            const ssTableData& dat = cursor.data();
+            uint64_t offset = def::isInlineValue(dat) ? cursor.inlineValue().data() - mapping : 
+                dat.offset;
+            keys.push_back(dat.key);
+            payloads.push_back(cachedPayload{ offset, dat.value_length });
+        }
+        cached_keys.build(cached_layout, keys, payloads);
+    }
+
+    // return the data of the key-value pair together with its inline value
+    std::optional<ssTableEntry> SSTable::get(const key_type& key) {
+        // min_key and max_key check, which doesn't need the file
+        if (key < header.min_key || key > header.max_key) {
             return std::nullopt;
         }
 
+        // the file is mapped by the first lookup reaching it
+        open();
+
         // bloomFilter
         if (!filter->query(key)) {
             return std::nullopt;
         }
 
-        // find the key
-        def::ssTableData* start = content->data, 
-            * end = content->data + content->header.key_value_pair_number;
-        auto it = std::lower_bound(start, end, key, 
+        // a cached table reads only the payload of the key it finds
+        if (!cached_keys.empty()) {
+            const cachedPayload* payload = cached_keys.find(key);
+            if (!payload) return std::nullopt;
+
+            ssTableData dat{ key, payload->offset, payload->value_length };
+            if (def::isInlineValue(dat)) {
+                return ssTableEntry{ dat, value_type(mapping + dat.offset, def::valueLength(dat)) };
+            }
+            return ssTableEntry{ dat, value_type() };
+        }
+
+        // find the key in the only block it may be in, where a packed one is searched
+        // without unpacking the others
+        size_t block_index = findBlock(key);
+        if (header.flags & def::sstable_packed_block_flag) {
+            std::string buffer;
+            std::string_view block = blockContent(block_index, buffer);
+            const char* src = block.data();
+            size_t size = block.size();
+            packedBlockReader reader(src, size);
+            size_t i = reader.lowerBound(key);
+            if (i == reader.size() || reader.key(i) != key) return std::nullopt;
+
+            ssTableData dat = reader.entry(i);
+            if (def::isInlineValue(dat)) {
+                std::string_view inline_values(src + reader.encodedSize(), 
+                    size - reader.encodedSize());
+                return ssTableEntry{ dat, 
+                    value_type(inline_values.substr(dat.offset, def::valueLength(dat))) };
+            }
+            return ssTableEntry{ dat, value_type() };
+        }
+
+        blockView current_block;
+        readBlock(block_index, current_block);
+        auto it = std::lower_bound(current_block.begin(), current_block.end(), key, 
             [](const def::ssTableData& dat, const key_type& key) -> bool 
             { return dat.key < key; });
 
         // key found
-        if (it != end && it->key == key) {
-            return std::make_pair(it->offset, it->value_length);
+        if (it != current_block.end() && it->key == key) {
+            if (def::isInlineValue(*it)) {
+                return ssTableEntry{ *it, value_type(current_block.inlineValue(*it)) };
+            }
+            return ssTableEntry{ *it, value_type() };
         }
 
         // key not found
         return std::nullopt;
     }
 
-    std::vector<ssTableData> SSTable::scan(
+    std::vector<ssTableEntry> SSTable::scan(
         const key_type& key1, const key_type& key2) {
-        // content shouldn't be equal to nullptr
-        assert(content);
+        // variable holding data and inline values
+        std::vector<ssTableEntry> vec;
 
-        // variable holding offset-vlen pair
-        std::vector<ssTableData> vec;
+        // min_key and max_key check, which doesn't need the file
+        if (key2 < header.min_key || key1 > header.max_key) {
+            return vec;
+        }
+        open();
 
-        // min_key and max_key check
-        if (key2 < content->header.min_key || key1 > content->header.max_key) {
+        // range filter, which is only asked about the part within the table
+        if (range_filter && !range_filter->query(std::max(key1, header.min_key), 
+            std::min(key2, header.max_key))) {
             return vec;
         }
 
-        // find the first key larger or equal than key1
-        def::ssTableData* start = content->data, 
-            * end = content->data + content->header.key_value_pair_number;
-        auto it = std::lower_bound(start, end, key1, 
-            [](const def::ssTableData& dat, const key_type& key) -> bool 
-            { return dat.key < key; });
+        // find the first key larger or equal than key1, and then all pairs with a smaller
+        // key than key2 from that block on
+        blockView current_block;
+        for (size_t block_index = findBlock(key1); block_index < block_number; ++block_index) {
+            if (index[block_index].first_key > key2) break;
 
-        // find all pairs with a smaller key than key2
-        while (it != end && it->key <= key2) {
-            vec.push_back(*it);
-            ++it;
+            readBlock(block_index, current_block);
+            auto it = std::lower_bound(current_block.begin(), current_block.end(), key1, 
+                [](const def::ssTableData& dat, const key_type& key) -> bool 
+                { return dat.key < key; });
+            for (; it != current_block.end() && it->key <= key2; ++it) {
+                if (def::isInlineValue(*it)) {
+                    vec.push_back(ssTableEntry{ *it, value_type(current_block.inlineValue(*it)) });
+                }
+                else {
+                    vec.push_back(ssTableEntry{ *it, value_type() });
+                }
+            }
         }
 
         return vec;
     }
+
+    ssTableCursor::ssTableCursor(const SSTable* table) : table(table) {
+        if (valid()) table->readBlock(0, current_block);
+    }
+
+    void ssTableCursor::next() {
+        // move to the next block after the last pair of this one
+        if (++index < current_block.key_value_pair_number) return;
+        index = 0;
+        if (++block_index < table->blockNumber()) table->readBlock(block_index, current_block);
+    }
 }
@@ -2,12 +2,21 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <string>
-#include <fstream>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 #include "../common/definitions.h"
+#include "../common/options.h"
 #include "../skipList/skipList.h"
 #include "../bloomFilter/bloomFilter.h"
+#include "../bloomFilter/rangeFilter.h"
+#include "../bloomFilter/xorFilter.h"
+#include "../learnedIndex/learnedIndex.h"
+#include "cachedKeys.h"
+#include "packedBlock.h"
 
 namespace sstable {
 
@@ -15,41 +24,153 @@ namespace sstable {
     using def::value_type;
     using def::ssTableContent;
     using def::ssTableData;
+    using def::ssTableEntry;
+    using keyFilter = bloomfilter::keyFilter<key_type>;
     using bloomFilter = bloomfilter::bloomFilter<key_type>;
+    using blockedBloomFilter = bloomfilter::blockedBloomFilter<key_type>;
+    using xorFilter = bloomfilter::xorFilter<key_type>;
+    using rangeFilter = bloomfilter::prefixRangeFilter<key_type>;
+    using learnedIndex = learnedindex::learnedIndex<key_type>;
+    using linearSegment = learnedindex::linearSegment<key_type>;
+
+    // build the filter of a complete content from its keys with the given bits for each
+    // key, whose type is in header.flags
+    void buildFilter(ssTableContent* content, double bits_per_key);
+    void buildRangeFilter(ssTableContent* content, double bits_per_key);
+
+    // read only the header of a table file
+    def::ssTableHeader readHeader(const std::string& file_name);
+
+    // the pairs of one data block and the inline values they refer to
+    struct blockView {
+        const ssTableData* data = nullptr;
+        size_t key_value_pair_number = 0;
+        std::string_view inline_values;
+
+        // the unpacked data of a packed block, and the bytes of a compressed block, which
+        // are reused by the next block
+        std::vector<ssTableData> decoded_data;
+        std::string decompressed_block;
+
+        const ssTableData* begin() const { return data; }
+        const ssTableData* end() const { return data + key_value_pair_number; }
+        std::string_view inlineValue(const ssTableData& dat) const {
+            return inline_values.substr(dat.offset, def::valueLength(dat));
+        }
+    };
 
     class SSTable
     {
     private:
         std::string file_name;
-        std::fstream file_stream;
 
         uint64_t timestamp = 0;
 
-        // read once upon a time
-        ssTableContent* content = nullptr;
+        // the file is mapped read-only, and the data and the inline values are read in
+        // place, so cached tables share the page cache and a lookup only touches its pages
+        const char* mapping = nullptr;
+        size_t mapping_size = 0;
+
+        // a table known by its header is read by lookups while it's being opened, so the
+        // header in the file is only checked against it, and the others take it from the
+        // file before they're shared
+        def::ssTableHeader header{};
+        bool has_header = false;
+
+        // the index of the data blocks, which is in the mapping for a block-based table,
+        // while a table written before blocks is one block of all its data
+        const def::ssTableBlockHandle* index = nullptr;
+        size_t block_number = 0;
+        def::ssTableBlockHandle whole_table_block{};
+
+        // the model predicting which block a key is in, which is empty without segments
+        learnedIndex block_model{ def::learned_index_error };
+
+        // the keys of a cached table, which are searched instead of the blocks
+        def::cached_table_layout cached_layout = def::cached_table_layout::blocks;
+        size_t max_cached_keys = 0;
+        cachedKeys cached_keys;
+        void buildCachedKeys();
+
+        // a table opened lazily is mapped once by whichever lookup comes first
+        std::once_flag open_flag;
+
+        // the data of tables written before it's aligned may not be read in place
+        std::vector<ssTableData> unaligned_data;
+
+        // the filter of the type written in the header, which a one-shot lookup reads in
+        // place in the mapping, and a cached table copies since every lookup probes it
+        std::unique_ptr<keyFilter> filter;
+        std::unique_ptr<rangeFilter> range_filter;
+        bool cached = false;
+        void createFilter(const char* src, size_t byte_count, uint32_t hashes);
+        void ownFilters();
 
-        // bloomFilter here
-        bloomFilter* filter = nullptr;
+        void unmap();
+
+        // the block the key would be in, which is the last one starting at or before it
+        size_t findBlock(const key_type& key) const;
+        // the bytes of a block, which are either in the mapping or decompressed into buffer
+        std::string_view blockContent(size_t block_index, std::string& buffer) const;
 
     public:
         explicit SSTable(const std::string& dir_name, uint64_t ts, size_t layer, 
             const std::string& name);
         explicit SSTable(const std::string& file_name);
+
+        // the table is known by the header alone until it's opened
+        SSTable(const std::string& file_name, const def::ssTableHeader& header);
         ~SSTable();
 
+        SSTable(const SSTable&) = delete;
+        SSTable& operator=(const SSTable&) = delete;
+
         void initialize();
 
-        void write(ssTableContent* content);
+        // ATTENTION! the content is deleted after it's written in blocks of about
+        // block_size bytes, each compressed with the codec, and the table is read from the
+        // file since then
+        void write(ssTableContent* content, size_t block_size, 
+            def::compression_type compression = def::compression_type::none);
         void load();
-        void flush();
 
-        std::optional<std::pair<uint64_t, uint32_t>> get(const key_type& key);
-        std::vector<ssTableData> scan(const key_type& key1, const key_type& key2);
+        // map the file unless it's mapped, which is safe for many threads at the same time
+        void open();
+
+        // the table is about to be read from the beginning to the end, like merging
+        void adviseSequential();
+
+        // the table is cached and probed by every lookup, so its keys are kept in memory
+        // once it's opened unless there're more than max_keys
+        void cacheKeys(def::cached_table_layout layout, size_t max_keys);
+
+        // whether lookups search the keys in memory instead of the blocks
+        bool keysCached() const { return !cached_keys.empty(); }
+
+        std::optional<ssTableEntry> get(const key_type& key);
+        std::vector<ssTableEntry> scan(const key_type& key1, const key_type& key2);
 
-        const ssTableContent* tableContent() const { return content; }
+        const def::ssTableHeader& tableHeader() const { return header; }
+        size_t blockNumber() const { return block_number; }
+        void readBlock(size_t block_index, blockView& view) const;
         const std::string& getFileName() const { return file_name; }
     };
 
-}
+    // reads the pairs of a table in order, one block after another
+    class ssTableCursor
+    {
+    private:
+        const SSTable* table;
+        size_t block_index = 0, index = 0;
+        blockView current_block;
 
+    public:
+        explicit ssTableCursor(const SSTable* table);
 
+        bool valid() const { return block_index < table->blockNumber(); }
+        const ssTableData& data() const { return current_block.data[index]; }
+        std::string_view inlineValue() const { return current_block.inlineValue(data()); }
+        void next();
+    };
+
+}
@@ -0,0 +1,70 @@
+#include "../kvstore.h"
+#include "utils.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace HI;
+
+const size_t TEST_MAX = 1e5;
+const size_t BATCH_SIZES[] = {1, 10, 100, 500};
+
+std::string valueOf(uint64_t key) {
+    // the value can be recomputed from the key for validation
+    return std::string(key % 100 + 1, 'a' + key % 26);
+}
+
+double testPut(KVStore &tree) {
+    auto binder = [&]() {
+        for (uint64_t key = 0; key < TEST_MAX; ++key) tree.put(key, valueOf(key));
+    };
+
+    // time for all operations
+    return timeSeconds(binder) / TEST_MAX;
+}
+
+double testWrite(KVStore &tree, size_t batch_size) {
+    auto binder = [&]() {
+        writeBatch batch;
+        for (uint64_t key = 0; key < TEST_MAX; ++key) {
+            batch.put(key, valueOf(key));
+            if (batch.size() == batch_size) {
+                tree.write(batch);
+                batch.clear();
+            }
+        }
+        tree.write(batch);
+    };
+
+    // time for all operations
+    return timeSeconds(binder) / TEST_MAX;
+}
+
+size_t validate(KVStore &tree) {
+    size_t mismatch = 0;
+    for (uint64_t key = 0; key < TEST_MAX; ++key) {
+        if (tree.get(key) != valueOf(key)) ++mismatch;
+    }
+    return mismatch;
+}
+
+int main() {
+    // create instance for LSMTree
+    KVStore tree("./data", "./data/vlog");
+    tree.reset();
+
+    std::cout << "/******************* single put *******************/\n";
+    std::cout << "Put average time: " << testPut(tree) << "ns\n";
+    std::cout << "Mismatched values: " << validate(tree) << '\n';
+
+    for (size_t batch_size : BATCH_SIZES) {
+        tree.reset();
+
+        std::cout << "/******************* batch of " << batch_size << " *******************/\n";
+        std::cout << "Put average time: " << testWrite(tree, batch_size) << "ns\n";
+        std::cout << "Mismatched values: " << validate(tree) << '\n';
+    }
+    tree.reset();
+
+    return 0;
+}
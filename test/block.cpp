@@ -0,0 +1,100 @@
+#include "../ssTable/packedBlock.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace HI;
+
+const size_t TEST_MAX = 1e4;
+
+// the entries of a block of 4 KB, and one which doesn't fill the last 4 lanes
+const size_t BLOCK_SIZES[] = {256, 255};
+
+static const size_t KIND_NUM = 4;
+static const std::string kind_str[KIND_NUM] = {
+    "values in vLog",
+    "inline values",
+    "mixed with tombstones",
+    "keys and offsets of 64 bits",
+};
+
+// sorted entries of a block of the kind, whose keys are close unless they take 64 bits
+std::vector<def::ssTableData> generateBlock(size_t kind, size_t n, std::mt19937_64 &rng) {
+    std::vector<def::ssTableData> block;
+    uint64_t key = rng() >> 8, v_log_offset = rng() >> 24, inline_offset = 0;
+    if (kind == 3) {
+        // the keys and the offsets spread over the whole range take 64 bits each
+        for (size_t i = 0; i < n; ++i) block.push_back({rng(), rng(), 1});
+        std::sort(block.begin(), block.end(),
+            [](const def::ssTableData &a, const def::ssTableData &b) { return a.key < b.key; });
+        return block;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        def::ssTableData dat{};
+        dat.key = key += rng() % 64 + 1;
+        uint32_t length = rng() % 4096 + 1;
+        size_t choice = kind == 2 ? rng() % 3 : kind;
+        if (choice == 0) {
+            dat.offset = v_log_offset;
+            dat.value_length = length;
+            v_log_offset += length + def::v_log_fixed_size;
+        }
+        else if (choice == 1) {
+            dat.offset = inline_offset;
+            dat.value_length = (length % 64) | def::inline_value_flag;
+            inline_offset += length % 64;
+        }
+        block.push_back(dat);
+    }
+    return block;
+}
+
+int main() {
+    std::mt19937_64 rng(time(nullptr));
+    std::cout << "SIMD decoding: " << (sstable::packedBlockReader::simdDecode() ? "AVX2" : "none")
+              << '\n';
+
+    for (size_t size : BLOCK_SIZES) {
+        for (size_t kind = 0; kind < KIND_NUM; ++kind) {
+            std::vector<def::ssTableData> block = generateBlock(kind, size, rng);
+            sstable::packedBlockBuilder builder;
+            for (const def::ssTableData &dat : block) builder.add(dat);
+            std::string bytes;
+            builder.finish(bytes);
+            sstable::packedBlockReader reader(bytes.data(), bytes.size());
+
+            std::cout << "/******* " << kind_str[kind] << ": " << size << " entries in "
+                      << bytes.size() << " bytes *******/\n";
+            std::vector<def::ssTableData> decoded, unpacked(size);
+            double result = timeSeconds([&]() {
+                for (size_t i = 0; i < TEST_MAX; ++i) reader.decode(decoded);
+            }) / TEST_MAX;
+            std::cout << "decode average time: " << result << "ns\n";
+
+            result = timeSeconds([&]() {
+                for (size_t i = 0; i < TEST_MAX; ++i) {
+                    for (size_t j = 0; j < size; ++j) unpacked[j] = reader.entry(j);
+                }
+            }) / TEST_MAX;
+            std::cout << "entry by entry average time: " << result << "ns\n";
+
+            // both ways must give back the entries of the block
+            size_t mismatch = 0;
+            for (size_t j = 0; j < size; ++j) {
+                mismatch += decoded[j].key != block[j].key || unpacked[j].key != block[j].key;
+                mismatch += decoded[j].offset != block[j].offset ||
+                    unpacked[j].offset != block[j].offset;
+                mismatch += decoded[j].value_length != block[j].value_length ||
+                    unpacked[j].value_length != block[j].value_length;
+            }
+            std::cout << "Mismatched entries: " << mismatch << '\n';
+            assert(!mismatch);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include "../kvstore.h"
+#include "utils.h"
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace HI;
+
+const size_t TEST_MAX = 1e5;
+const size_t STRING_LEN_MAX = 1e3;
+const size_t THREAD_NUMBERS[] = {1, 2, 4, 8, 16};
+
+std::string valueOf(uint64_t key) {
+    // the value can be recomputed from the key for validation
+    return std::string(key % STRING_LEN_MAX + 1, 'a' + key % 26);
+}
+
+double testPut(KVStore &tree, size_t thread_number) {
+    auto binder = [&]() {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < thread_number; ++t) {
+            // each thread inserts its own keys
+            threads.emplace_back([&tree, t, thread_number]() {
+                for (uint64_t key = t; key < TEST_MAX; key += thread_number) {
+                    tree.put(key, valueOf(key));
+                }
+            });
+        }
+        for (std::thread &thread : threads) thread.join();
+    };
+
+    // time for all operations
+    return timeSeconds(binder) / TEST_MAX;
+}
+
+double testGet(KVStore &tree, size_t thread_number, size_t &mismatch) {
+    std::vector<size_t> mismatches(thread_number, 0);
+
+    auto binder = [&]() {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < thread_number; ++t) {
+            // each thread validates its own keys
+            threads.emplace_back([&tree, &mismatches, t, thread_number]() {
+                for (uint64_t key = t; key < TEST_MAX; key += thread_number) {
+                    if (tree.get(key) != valueOf(key)) ++mismatches[t];
+                }
+            });
+        }
+        for (std::thread &thread : threads) thread.join();
+    };
+
+    // time for all operations
+    double result = timeSeconds(binder) / TEST_MAX;
+    for (size_t count : mismatches) mismatch += count;
+    return result;
+}
+
+int main() {
+    // create instance for LSMTree
+    KVStore tree("./data", "./data/vlog");
+
+    // start testing
+    for (size_t thread_number : THREAD_NUMBERS) {
+        size_t mismatch = 0;
+        tree.reset();
+
+        std::cout << "/******************* " << thread_number << " threads *******************/\n";
+        std::cout << "Put average time: " << testPut(tree, thread_number) << "ns\n";
+        std::cout << "Get average time: " << testGet(tree, thread_number, mismatch) << "ns\n";
+        std::cout << "Mismatched values: " << mismatch << '\n';
+    }
+    tree.reset();
+
+    return 0;
+}
@@ -1,14 +1,19 @@
 #include "../kvstore.h"
+#include "../bloomFilter/xorFilter.h"
 #include "utils.h"
 #include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <iostream>
+#include <list>
 #include <unistd.h>
+#include <vector>
 
 using namespace HI;
 
 const size_t TEST_MAX = 1e5;
 const size_t STRING_LEN_MAX = 1e4;
+const size_t SCAN_LENGTH = 100;
 
 std::string randomString(size_t length) {
     auto randchar = []() -> char {
@@ -52,30 +57,116 @@ double testGet(KVStore &tree, size_t MAX) {
     return result / MAX;
 }
 
-static const size_t TEST_NUM = 2;
+// most short scans among random keys find nothing, which the range filter answers
+double testShortScan(KVStore &tree, size_t MAX) {
+    double result = 0;
+
+    for (size_t i = 0; i < MAX; ++i) {
+        // generate random data
+        uint64_t key1 = rand(), key2 = key1 + SCAN_LENGTH;
+        std::list<std::pair<key_type, value_type>> list;
+
+        // time for the operation
+        result += timeSeconds([&]() { tree.scan(key1, key2, list); });
+    }
+
+    return result / MAX;
+}
+
+const size_t BITS_PER_KEY = 10;
+
+// the number of hashes of bloom filters and the bits of fingerprints of xor filters,
+// which give the same false positive rate with BITS_PER_KEY
+const size_t HASHES = 7;
+
+// probe a full SSTable's filter, which holds the even keys, with absent keys, and
+// return the time of a probe
+template <typename Filter>
+double testProbe(const Filter &filter, double &false_positive_rate) {
+    size_t false_positives = 0;
+    auto binder = [&]() {
+        for (size_t i = 0; i < TEST_MAX; ++i) {
+            false_positives += filter.query(i * 2 + 1);
+        }
+    };
+
+    double result = timeSeconds(binder) / TEST_MAX;
+    false_positive_rate = (double)false_positives / TEST_MAX;
+    return result;
+}
+
+static const size_t TEST_NUM = 3;
 static double (*const func[TEST_NUM])(KVStore &, size_t) = {
     testPut,
     testGet,
+    testShortScan,
 };
 static const size_t test_size[TEST_NUM] = {
     TEST_MAX,
     TEST_MAX,
+    TEST_MAX / 10,
 };
 static const std::string func_str[TEST_NUM] = {
     "/******************* Testing Put *******************/",
     "/******************* Testing Get *******************/",
+    "/***************** Testing Short Scan ****************/",
 };
 
 int main() {
     // randomize seed
     srand(time(nullptr));
 
+    // compare the filters alone
+    double rate = 0, result = 0;
+    size_t key_number = def::storeOptions().sstable_target_size / def::sstable_data_size;
+    size_t bytes = key_number * BITS_PER_KEY / 8;
+    std::vector<uint64_t> keys;
+    for (uint64_t key = 0; key < key_number; ++key) keys.push_back(key * 2);
+    std::cout << "/******************* Testing Probe *******************/\n";
+    std::cout << BITS_PER_KEY << " bits for each of " << keys.size() << " keys\n";
+
+    bloomfilter::bloomFilter<uint64_t> bloom(bytes, HASHES);
+    for (uint64_t key : keys) bloom.insert(key);
+    result = testProbe(bloom, rate);
+    std::cout << "bloom average time: " << result << "ns (false positive rate "
+              << rate << ", " << bytes << " bytes)\n";
+
+    bloomfilter::blockedBloomFilter<uint64_t> blocked(bytes);
+    for (uint64_t key : keys) blocked.insert(key);
+    result = testProbe(blocked, rate);
+    std::cout << "blocked bloom average time: " << result << "ns (false positive rate "
+              << rate << ", " << blocked.size() << " bytes)\n";
+
+    // the SIMD probe answers like the scalar one, also for the fewer words of older filters
+    // and for a filter read in place at an offset of a file, whose blocks aren't aligned
+    size_t mismatch = 0;
+    bloomfilter::blockedBloomFilter<uint64_t> older(bytes, 3);
+    for (uint64_t key : keys) older.insert(key);
+    std::vector<uint64_t> file_words(blocked.size() / sizeof(uint64_t) + 1);
+    memcpy(file_words.data() + 1, blocked.getContent(), blocked.size());
+    bloomfilter::blockedBloomFilter<uint64_t> in_place(
+        (const unsigned char*)(file_words.data() + 1), blocked.size(), blocked.maxHashes());
+    for (uint64_t key = 0; key < keys.size() * 2; ++key) {
+        mismatch += blocked.query(key) != blocked.queryScalar(key);
+        mismatch += older.query(key) != older.queryScalar(key);
+        mismatch += in_place.query(key) != blocked.query(key);
+    }
+    std::cout << "blocked bloom SIMD probe: " << (bloomfilter::simdProbe() ? "AVX2" : "none")
+              << ", mismatched answers: " << mismatch << '\n';
+
+    using xorFilter = bloomfilter::xorFilter<uint64_t>;
+    xorFilter xor_filter(xorFilter::bytesFor(keys.size(), HASHES), HASHES);
+    xor_filter.build(keys);
+    result = testProbe(xor_filter, rate);
+    std::cout << "xor average time: " << result << "ns (false positive rate "
+              << rate << ", " << xor_filter.size() << " bytes)\n";
+
     // create instance for LSMTree
     KVStore tree("./data", "./data/vlog");
 
     // start testing
-    std::cout << "Current size of BloomFilter: " << def::bloom_filter_size
-              << "bytes\n";
+    std::cout << "Current bits of BloomFilter for each key: "
+              << def::storeOptions().filter_bits_per_key << " in the deepest level\n";
     for (size_t i = 0; i < TEST_NUM; ++i) {
         std::cout << func_str[i] << '\n';
         std::cout << "Average time: " << func[i](tree, test_size[i]) << "ns\n";
@@ -0,0 +1,67 @@
+#include "../wal/wal.h"
+#include "utils.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace HI;
+using namespace wal;
+
+const size_t TEST_MAX = 2e4;
+const size_t THREAD_NUMBERS[] = {1, 2, 4, 8, 16};
+const std::string VALUE(100, 'w');
+
+struct policyChoice {
+    const char *name;
+    wal_sync_policy policy;
+};
+
+const policyChoice POLICIES[] = {
+    {"every write", wal_sync_policy::every_write},
+    {"interval", wal_sync_policy::interval},
+    {"never", wal_sync_policy::never},
+};
+
+double testAppend(writeAheadLog &log, size_t thread_number) {
+    auto binder = [&]() {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < thread_number; ++t) {
+            // each thread appends its own keys
+            threads.emplace_back([&log, t, thread_number]() {
+                for (uint64_t key = t; key < TEST_MAX; key += thread_number) {
+                    std::string record;
+                    writeAheadLog::encode(record, key, entry_view{entry_kind::value, VALUE});
+                    log.append(record);
+                }
+            });
+        }
+        for (std::thread &thread : threads) thread.join();
+    };
+
+    // time for all operations
+    return timeSeconds(binder) / TEST_MAX;
+}
+
+int main() {
+    for (const policyChoice &choice : POLICIES) {
+        std::cout << "/******************* " << choice.name << " *******************/\n";
+
+        for (size_t thread_number : THREAD_NUMBERS) {
+            writeAheadLog log("./data", choice.policy, 10);
+            double result = testAppend(log, thread_number);
+            size_t syncs = log.syncCount();
+
+            // concurrent writers share one sync with group commit
+            std::cout << thread_number << " threads average time: " << result << "ns"
+                      << " (" << syncs << " syncs, "
+                      << (syncs ? TEST_MAX / syncs : 0) << " appends per sync)\n";
+
+            // leave nothing for the next round
+            log.clear();
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include "../learnedIndex/learnedIndex.h"
+#include "../ssTable/ssTable.h"
+#include "../utils.h"
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace HI;
+
+const size_t TEST_MAX = 1e6;
+
+// the first keys of the blocks of one SSTable, and the keys of a large sorted array
+const size_t TEST_SIZES[] = {512, 1000000};
+const size_t ERROR = 8;
+
+static const size_t DIST_NUM = 4;
+static const std::string dist_str[DIST_NUM] = {
+    "sequential",
+    "uniform",
+    "clustered",
+    "lognormal",
+};
+
+// sorted distinct keys of the distribution
+std::vector<uint64_t> generateKeys(size_t dist, size_t n, std::mt19937_64 &rng) {
+    std::vector<uint64_t> keys;
+    switch (dist) {
+    case 0:
+        // keys written one after another
+        for (size_t i = 0; i < n; ++i) keys.push_back(i);
+        break;
+    case 1:
+        for (size_t i = 0; i < n; ++i) keys.push_back(rng());
+        break;
+    case 2: {
+        // runs of close keys far away from each other, like those of several writers
+        uint64_t key = 0;
+        for (size_t i = 0; i < n; ++i) {
+            key += i % 1000 ? rng() % 16 + 1 : rng() >> 20;
+            keys.push_back(key);
+        }
+        break;
+    }
+    default: {
+        std::lognormal_distribution<double> lognormal(0, 2);
+        for (size_t i = 0; i < n; ++i) keys.push_back((uint64_t)(lognormal(rng) * 1e9));
+        break;
+    }
+    }
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+// look up each query and return the time of a lookup
+template <typename Search>
+double testSearch(const std::vector<uint64_t> &queries, Search search, size_t &checksum) {
+    auto binder = [&]() {
+        for (uint64_t query : queries) checksum += search(query);
+    };
+
+    return timeSeconds(binder) / queries.size();
+}
+
+// a table of the default target size, searched by its blocks and by the keys cached in
+// the default layout, which such a table is small enough for
+void testCachedTable(std::mt19937_64 &rng) {
+    def::storeOptions options;
+    std::vector<uint64_t> keys = generateKeys(1, 
+        options.sstable_target_size / def::sstable_data_size, rng);
+
+    // the table is written like a flushed one, with its values in vLog
+    auto *content = new def::ssTableContent;
+    for (uint64_t key : keys) content->data.push_back({key, rng() >> 24, 100});
+    content->header.time = 1;
+    content->header.key_value_pair_number = static_cast<uint32_t>(keys.size());
+    content->header.min_key = keys.front();
+    content->header.max_key = keys.back();
+    content->header.flags = static_cast<uint32_t>(options.sstable_filter);
+    if (options.sstable_packed_blocks) content->header.flags |= def::sstable_packed_block_flag;
+    if (options.learned_index) content->header.flags |= def::sstable_learned_index_flag;
+    sstable::buildFilter(content, options.filter_bits_per_key);
+    sstable::SSTable writer("./data", 1, 0, "index");
+    writer.write(content, options.sstable_block_size);
+
+    sstable::SSTable blocks(writer.getFileName(), writer.tableHeader());
+    blocks.cacheKeys(def::cached_table_layout::blocks, 0);
+    sstable::SSTable cached(writer.getFileName(), writer.tableHeader());
+    cached.cacheKeys(options.cached_layout, def::maxCachedKeyNumber(options.sstable_target_size));
+    blocks.open();
+    cached.open();
+
+    std::vector<uint64_t> queries;
+    for (size_t i = 0; i < TEST_MAX; ++i) {
+        uint64_t key = keys[rng() % keys.size()];
+        queries.push_back(i % 2 ? key : key + 1);
+    }
+
+    std::cout << "/******* SSTable of " << keys.size() << " keys *******/\n";
+    size_t expected = 0, checksum = 0;
+    double result = testSearch(queries, [&blocks](uint64_t key) {
+        return blocks.get(key).has_value();
+    }, expected);
+    std::cout << "blocks average time: " << result << "ns\n";
+    result = testSearch(queries, [&cached](uint64_t key) {
+        return cached.get(key).has_value();
+    }, checksum);
+    std::cout << "cached keys average time: " << result << "ns (in use with default options: "
+              << (cached.keysCached() ? "yes" : "no") << ")\n";
+
+    // both find the same keys
+    assert(cached.keysCached() && checksum == expected);
+    utils::rmfile(writer.getFileName());
+    utils::rmdir(def::getLevelDirectoryPath("./data", 0));
+}
+
+int main() {
+    std::mt19937_64 rng(time(nullptr));
+
+    for (size_t size : TEST_SIZES) {
+        for (size_t dist = 0; dist < DIST_NUM; ++dist) {
+            std::vector<uint64_t> keys = generateKeys(dist, size, rng);
+            std::vector<uint64_t> queries;
+            for (size_t i = 0; i < TEST_MAX; ++i) {
+                // half of them are present keys, and the others are between them
+                uint64_t key = keys[rng() % keys.size()];
+                queries.push_back(i % 2 ? key : key + 1);
+            }
+
+            learnedindex::learnedIndex<uint64_t> model(ERROR);
+            auto key_at = [&keys](size_t i) { return keys[i]; };
+            double build = timeSeconds([&]() { model.build(key_at, keys.size()); });
+
+            std::cout << "/******* " << dist_str[dist] << " keys: " << keys.size()
+                      << " *******/\n";
+            size_t expected = 0, checksum = 0;
+            double result = testSearch(queries, [&keys](uint64_t key) {
+                return std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+            }, expected);
+            std::cout << "lower_bound average time: " << result << "ns\n";
+
+            result = testSearch(queries, [&](uint64_t key) {
+                return model.lowerBound(key_at, keys.size(), key);
+            }, checksum);
+            std::cout << "learned index average time: " << result << "ns ("
+                      << model.size() << " segments, built in " << build / 1e6 << "ms)\n";
+
+            // both searches must give the same positions
+            assert(checksum == expected);
+        }
+    }
+    testCachedTable(rng);
+
+    return 0;
+}
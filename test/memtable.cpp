@@ -0,0 +1,84 @@
+#include "../memTable/memTableRep.h"
+#include "utils.h"
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace HI;
+using namespace memtable;
+
+const size_t TEST_MAX = 1e5;
+const size_t SCAN_LENGTH = 100;
+const std::string VALUE(64, 's');
+
+struct repChoice {
+    const char *name;
+    def::memtable_type type;
+};
+
+const repChoice REPS[] = {
+    {"skiplist", def::memtable_type::skiplist},
+    {"hash table", def::memtable_type::hash_table},
+    {"b+ tree", def::memtable_type::bplus_tree},
+};
+
+// the mix of operations, the rest of which are puts
+struct workload {
+    const char *name;
+    size_t get_percent;
+    size_t scan_percent;
+};
+
+const workload WORKLOADS[] = {
+    {"put-heavy", 5, 0},
+    {"get-heavy", 90, 0},
+    {"scan-heavy", 0, 20},
+};
+
+double testWorkload(memTableRep &rep, const workload &load, size_t &visited) {
+    std::mt19937_64 engine(0);
+    std::uniform_int_distribution<uint64_t> key_distribution(0, TEST_MAX - 1);
+    std::uniform_int_distribution<size_t> op_distribution(0, 99);
+
+    auto binder = [&]() {
+        for (size_t i = 0; i < TEST_MAX; ++i) {
+            uint64_t key = key_distribution(engine);
+            size_t op = op_distribution(engine);
+
+            if (op < load.get_percent) {
+                visited += rep.get(key).has_value();
+            } else if (op < load.get_percent + load.scan_percent) {
+                rep.scan(key, key + SCAN_LENGTH,
+                    [&visited](const key_type &, const entry_view &) { ++visited; });
+            } else {
+                rep.put(key, VALUE);
+            }
+        }
+    };
+
+    // time for all operations
+    return timeSeconds(binder) / TEST_MAX;
+}
+
+int main() {
+    for (const workload &load : WORKLOADS) {
+        std::cout << "/******************* " << load.name << " *******************/\n";
+
+        for (const repChoice &choice : REPS) {
+            std::unique_ptr<memTableRep> rep = createMemTableRep(choice.type);
+            size_t visited = 0;
+
+            // half of the keys are there before the workload starts
+            for (uint64_t key = 0; key < TEST_MAX; key += 2) rep->put(key, VALUE);
+
+            double result = testWorkload(*rep, load, visited);
+            std::cout << choice.name << " average time: " << result << "ns"
+                      << " (" << rep->memoryUsage() << " bytes, " << visited << " visited)\n";
+        }
+    }
+
+    return 0;
+}
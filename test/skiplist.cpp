@@ -0,0 +1,174 @@
+#include "../skipList/skipList.h"
+#include "utils.h"
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+using namespace HI;
+
+const size_t TEST_MAX = 1e6;
+const size_t TEST_SIZES[] = {1000, 100000, 1000000};
+const std::string VALUE(8, 's');
+
+// the old layout, which holds a vector of heap allocated search nodes for each key
+namespace legacy {
+
+    using skiplist::key_type;
+    using skiplist::value_type;
+
+    class baseDataNode;
+
+    struct searchDataNode {
+        key_type* key;
+        searchDataNode* next = nullptr;
+        baseDataNode* parent;
+    };
+
+    class baseDataNode {
+    public:
+        key_type* key;
+        value_type value;
+        baseDataNode* next = nullptr;
+        std::vector<searchDataNode*> nodes;
+
+        baseDataNode() : key(nullptr) {}
+        baseDataNode(const key_type& cur_key) : key(new key_type(cur_key)) {}
+        ~baseDataNode() {
+            for (searchDataNode* node : nodes) delete node;
+            if (key) delete key;
+        }
+
+        searchDataNode* addNewSearchNode() {
+            searchDataNode* new_node = new searchDataNode();
+            new_node->key = key;
+            new_node->parent = this;
+            nodes.push_back(new_node);
+            return new_node;
+        }
+    };
+
+    class skiplist_type {
+    private:
+        baseDataNode* head;
+
+        searchDataNode* findAndInsert(const key_type& key, const value_type& val,
+            size_t cur_layer, baseDataNode* cur_base_node) {
+            if (!cur_layer) {
+                baseDataNode* new_base_node = new baseDataNode(key);
+                new_base_node->next = cur_base_node->next;
+                cur_base_node->next = new_base_node;
+                new_base_node->value = val;
+                return new_base_node->addNewSearchNode();
+            }
+
+            searchDataNode* cur_search_node = cur_base_node->nodes[cur_layer - 1];
+            while (cur_search_node->next && *(cur_search_node->next->key) <= key) {
+                cur_search_node = cur_search_node->next;
+            }
+            cur_base_node = cur_search_node->parent;
+
+            if (cur_search_node->key && *(cur_search_node->key) == key) {
+                cur_base_node->value = val;
+                return nullptr;
+            }
+
+            searchDataNode* next_node = findAndInsert(key, val, cur_layer - 1, cur_base_node);
+            if (next_node) {
+                next_node->next = cur_search_node->next;
+                cur_search_node->next = next_node;
+                next_node = (rand() & 1) ? next_node->parent->addNewSearchNode() : nullptr;
+            }
+            return next_node;
+        }
+
+    public:
+        skiplist_type() : head(new baseDataNode()) { head->addNewSearchNode(); }
+        ~skiplist_type() {
+            while (head->next) {
+                baseDataNode* next_node = head->next;
+                head->next = next_node->next;
+                delete next_node;
+            }
+            delete head;
+        }
+
+        void put(const key_type& key, const value_type& val) {
+            searchDataNode* new_node = findAndInsert(key, val, head->nodes.size(), head);
+            if (new_node) {
+                searchDataNode* new_head_node = head->addNewSearchNode();
+                new_node->next = new_head_node->next;
+                new_head_node->next = new_node;
+            }
+        }
+
+        std::optional<value_type> get(const key_type& key) const {
+            baseDataNode* cur_base_node = head;
+            for (size_t layer = head->nodes.size(); layer; --layer) {
+                searchDataNode* cur_search_node = cur_base_node->nodes[layer - 1];
+                while (cur_search_node->next && *(cur_search_node->next->key) <= key) {
+                    cur_search_node = cur_search_node->next;
+                }
+                cur_base_node = cur_search_node->parent;
+                if (cur_base_node->key && *(cur_base_node->key) == key) {
+                    return cur_base_node->value;
+                }
+            }
+            return std::nullopt;
+        }
+    };
+
+}
+
+template <typename List>
+double testPut(List &list, const std::vector<uint64_t> &keys) {
+    double result = 0;
+
+    for (uint64_t key : keys) {
+        // time for the operation
+        result += timeSeconds([&]() { list.put(key, VALUE); });
+    }
+
+    return result / keys.size();
+}
+
+template <typename List>
+double testGet(List &list, const std::vector<uint64_t> &keys) {
+    double result = 0;
+    volatile size_t found = 0;
+
+    for (size_t i = 0; i < TEST_MAX; ++i) {
+        // half of the keys are hit
+        uint64_t key = (i & 1) ? keys[rand() % keys.size()] : rand();
+
+        // time for the operation
+        result += timeSeconds([&]() { found += list.get(key).has_value(); });
+    }
+
+    return result / TEST_MAX;
+}
+
+int main() {
+    // randomize seed
+    srand(time(nullptr));
+
+    for (size_t size : TEST_SIZES) {
+        // generate random keys shared by both layouts
+        std::vector<uint64_t> keys(size);
+        for (uint64_t &key : keys) key = rand();
+
+        std::cout << "/****************** " << size << " keys ******************/\n";
+        {
+            legacy::skiplist_type list;
+            std::cout << "Legacy put average time: " << testPut(list, keys) << "ns\n";
+            std::cout << "Legacy get average time: " << testGet(list, keys) << "ns\n";
+        }
+        {
+            skiplist::skiplist_type list;
+            std::cout << "Inline put average time: " << testPut(list, keys) << "ns\n";
+            std::cout << "Inline get average time: " << testGet(list, keys) << "ns\n";
+        }
+    }
+
+    return 0;
+}
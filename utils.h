@@ -103,6 +103,47 @@ namespace utils
         return ::unlink(path.c_str());
     }
 
+    /**
+     * Force the data of a file onto the disk
+     * @param path file to be synced.
+     * @return 0 if synced successfully, -1 otherwise.
+     * @attention the data written through any descriptor or stream of the file is synced,
+     * as long as it has left the buffers of the process.
+     */
+    static inline int syncFile(const std::string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            perror("open");
+            return -1;
+        }
+        int ret = fdatasync(fd);
+        if (ret != 0) perror("fdatasync");
+        close(fd);
+        return ret;
+    }
+
+    /**
+     * Force the entries of a directory onto the disk, so files created, renamed or deleted in it
+     * survive a crash
+     * @param path directory to be synced.
+     * @return 0 if synced successfully, -1 otherwise.
+     */
+    static inline int syncDir(const std::string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd < 0)
+        {
+            perror("open");
+            return -1;
+        }
+        int ret = fsync(fd);
+        if (ret != 0) perror("fsync");
+        close(fd);
+        return ret;
+    }
+
     /**
      * Reclaim space of a file
      * @param path file to be reclaimed.
@@ -186,17 +227,28 @@ namespace utils
     /**
      * generate crc16
      * @param data binary data used to generate crc16.
+     * @param length number of bytes of data.
+     * @param crc crc16 of the data before, to continue from.
      * @return generated crc16.
      */
-    static inline uint16_t crc16(const std::vector<unsigned char> &data)
+    static inline uint16_t crc16(const unsigned char *data, size_t length, uint16_t crc = 0xFFFF)
     {
         static const std::unique_ptr<uint16_t[]> crc16_table = generate_crc16_table();
-        uint16_t crc = 0xFFFF;
-        size_t i = 0, length = data.size();
+        size_t i = 0;
         while (i < length)
         {
             crc = (crc << 8) ^ crc16_table[((crc >> 8) ^ data[i++]) & 0xFF];
         }
         return crc;
     }
+
+    /**
+     * generate crc16
+     * @param data binary data used to generate crc16.
+     * @return generated crc16.
+     */
+    static inline uint16_t crc16(const std::vector<unsigned char> &data)
+    {
+        return crc16(data.data(), data.size());
+    }
 }
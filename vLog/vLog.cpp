@@ -3,6 +3,8 @@
 #include <filesystem>
 #include <iostream>
 #include "vLog.h"
+#include "../checksum/checksum.h"
+#include "../compression/compression.h"
 #include "../common/exceptions.h"
 
 namespace vlog {
@@ -30,15 +32,18 @@ namespace vlog {
 
     void vLog::initialize() {
         // prepare to assign for head
-        size_t cur_pos = utils::seek_data_block(file_name);
+        off_t data_pos = utils::seek_data_block(file_name);
         def::vLogEntry entry;
-        unsigned char* read_buffer = new unsigned char[def::v_log_fixed_size];
+        char read_buffer[def::compressed_v_log_fixed_size];
         unsigned char* check_buffer = new unsigned char[def::v_log_initialization_check_size];
 
         // head here
         file_stream.seekp(0, std::ios::end);
         head = file_stream.tellp();
 
+        // an empty file, or one whose entries are all collected, has no data to seek
+        size_t cur_pos = data_pos < 0 ? head : data_pos;
+
         // read from file
         file_stream.seekg(0, std::ios::beg);
 
@@ -50,40 +55,24 @@ namespace vlog {
 
             bool found = false;
             for (size_t i = 0; i < bound; ++i, ++cur_pos) {
-                if (check_buffer[i] == def::start_sign) {
-                    // read from file into buffer
-                    file_stream.seekg(cur_pos, std::ios::beg);
-                    file_stream.read((char*)read_buffer, def::v_log_fixed_size);
-
-                    // read from buffer into entry
-                    size_t accumulated_count = 0;
-                    def::read_from_buffer((char*)&entry.start, (char*)read_buffer, 
-                        sizeof(entry.start), accumulated_count);
-                    def::read_from_buffer((char*)&entry.cycSum, (char*)read_buffer, 
-                        sizeof(entry.cycSum), accumulated_count);
-                    size_t start_pos = accumulated_count;
-                    def::read_from_buffer((char*)&entry.key, (char*)read_buffer, 
-                        sizeof(entry.key), accumulated_count);
-                    def::read_from_buffer((char*)&entry.value_length, (char*)read_buffer, 
-                        sizeof(entry.value_length), accumulated_count);
-
-                    // value here
-                    char* val = new char[entry.value_length + 1];
-                    val[entry.value_length] = '\0';
-                    file_stream.read(val, entry.value_length);
-
-                    // try to validate the entry
-                    std::vector<unsigned char> vec(read_buffer + start_pos, 
-                        read_buffer + accumulated_count);
-                    vec.insert(vec.cend(), val, val + entry.value_length);
-                    uint16_t calculated_cycSum = utils::crc16(vec);
-                    delete [] val;
-
-                    // find the right entry
-                    if (entry.cycSum == calculated_cycSum) {
-                        found = true;
-                        break;
-                    }
+                // the entry can't go beyond the file
+                size_t fixed_size = def::vLogFixedSize(check_buffer[i]);
+                if (!fixed_size || cur_pos + fixed_size > head) continue;
+
+                // read from file into buffer
+                file_stream.seekg(cur_pos, std::ios::beg);
+                file_stream.read(read_buffer, fixed_size);
+                readEntryHeader(read_buffer, entry);
+                if (cur_pos + fixed_size + entry.value_length > head) continue;
+
+                // value here
+                entry.value.resize(entry.value_length);
+                file_stream.read(entry.value.data(), entry.value_length);
+
+                // find the right entry
+                if (validEntry(read_buffer, entry.value)) {
+                    found = true;
+                    break;
                 }
             }
 
@@ -93,7 +82,6 @@ namespace vlog {
 
         // assign tail and release memory
         tail = cur_pos;
-        delete [] read_buffer;
         delete [] check_buffer;
     }
 
@@ -111,36 +99,108 @@ namespace vlog {
         }
     }
 
-    uint64_t vLog::writeIntoFile(def::vLogEntry& entry) {
-        file_stream.seekp(0, std::ios::end);
-        uint64_t start_pos = file_stream.tellp();
-
-        size_t dynamic_size = entry.value_length;
-        char* write_buffer = new char[def::v_log_fixed_size + dynamic_size];
-
-        // key, vlen and value
-        size_t buffer_start = sizeof(entry.start) + sizeof(entry.cycSum);
-        memcpy(write_buffer + buffer_start, &entry.key, sizeof(entry.key));
-        size_t buffer_end = buffer_start + sizeof(entry.key);
-        memcpy(write_buffer + buffer_end, &entry.value_length, sizeof(entry.value_length));
-        buffer_end += sizeof(entry.value_length);
-        memcpy(write_buffer + buffer_end, entry.value.c_str(), dynamic_size);
-        buffer_end += dynamic_size;
+    uint32_t vLog::serializeEntry(const key_type& key, std::string_view val, 
+        def::compression_type compression) {
+        // a value which shrinks is stored compressed, with its length before it
+        uint32_t raw_length = static_cast<uint32_t>(val.length());
+        bool compressed = compression::compress(compression, val, compressed_value);
+        if (compressed) val = compressed_value;
+        unsigned char start = compressed ? def::compressed_start_sign : def::start_sign;
+        size_t fixed_size = def::vLogFixedSize(start);
+
+        size_t start_pos = write_buffer.size();
+        uint32_t value_length = static_cast<uint32_t>(val.length());
+        write_buffer.resize(start_pos + fixed_size + value_length);
+        char* buffer = write_buffer.data() + start_pos;
+
+        // key, vlen, the length before compression with the codec, and value
+        size_t buffer_start = sizeof(start) + sizeof(uint32_t);
+        memcpy(buffer + buffer_start, &key, sizeof(key));
+        size_t buffer_end = buffer_start + sizeof(key);
+        memcpy(buffer + buffer_end, &value_length, sizeof(value_length));
+        buffer_end += sizeof(value_length);
+        if (compressed) {
+            uint8_t codec = static_cast<uint8_t>(compression);
+            memcpy(buffer + buffer_end, &raw_length, sizeof(raw_length));
+            buffer_end += sizeof(raw_length);
+            memcpy(buffer + buffer_end, &codec, sizeof(codec));
+            buffer_end += sizeof(codec);
+        }
+        memcpy(buffer + buffer_end, val.data(), value_length);
+        buffer_end += value_length;
 
         // cycSum calculation
-        std::vector<unsigned char> united_entry(write_buffer + buffer_start, write_buffer + buffer_end);
-        entry.cycSum = utils::crc16(united_entry);
+        uint32_t cycSum = checksum::crc32c(buffer + buffer_start, buffer_end - buffer_start);
 
         // start tag and cycSum
-        memcpy(write_buffer, &entry.start, sizeof(entry.start));
-        memcpy(write_buffer + sizeof(entry.start), &entry.cycSum, sizeof(entry.cycSum));
+        memcpy(buffer, &start, sizeof(start));
+        memcpy(buffer + sizeof(start), &cycSum, sizeof(cycSum));
+        return value_length;
+    }
+
+    size_t vLog::readEntryHeader(const char* src, def::vLogEntry& entry) {
+        size_t cur_pos = 0;
+        def::read_from_buffer((char*)&entry.start, (char*)src, sizeof(entry.start), cur_pos);
+
+        // the checksum of an older entry is a crc16
+        entry.cycSum = 0;
+        size_t check_sum_size = entry.start == def::crc16_start_sign ? sizeof(uint16_t) : 
+            sizeof(uint32_t);
+        def::read_from_buffer((char*)&entry.cycSum, (char*)src, check_sum_size, cur_pos);
+        def::read_from_buffer((char*)&entry.key, (char*)src, sizeof(entry.key), cur_pos);
+        def::read_from_buffer((char*)&entry.value_length, (char*)src, 
+            sizeof(entry.value_length), cur_pos);
 
-        // write into file using fstream and release memory
-        file_stream.write(write_buffer, def::v_log_fixed_size + dynamic_size);
-        delete [] write_buffer;
+        // only a compressed value has the length before compression and the codec
+        entry.raw_length = entry.value_length;
+        entry.compression = static_cast<uint8_t>(def::compression_type::none);
+        if (entry.start == def::compressed_start_sign) {
+            def::read_from_buffer((char*)&entry.raw_length, (char*)src, 
+                sizeof(entry.raw_length), cur_pos);
+            def::read_from_buffer((char*)&entry.compression, (char*)src, 
+                sizeof(entry.compression), cur_pos);
+        }
+        return cur_pos;
+    }
+
+    bool vLog::validEntry(const char* src, std::string_view value) {
+        unsigned char start = src[0];
+        size_t fixed_size = def::vLogFixedSize(start);
+        if (start == def::crc16_start_sign) {
+            uint16_t check_sum;
+            memcpy(&check_sum, src + sizeof(start), sizeof(check_sum));
+            size_t checked_start = sizeof(start) + sizeof(check_sum);
+            uint16_t crc = utils::crc16((const unsigned char*)src + checked_start, 
+                fixed_size - checked_start);
+            return check_sum == utils::crc16((const unsigned char*)value.data(), 
+                value.length(), crc);
+        }
+        if (!fixed_size) return false;
+
+        uint32_t check_sum;
+        memcpy(&check_sum, src + sizeof(start), sizeof(check_sum));
+        size_t checked_start = sizeof(start) + sizeof(check_sum);
+        uint32_t crc = checksum::crc32c(src + checked_start, fixed_size - checked_start);
+        return check_sum == checksum::crc32c(value.data(), value.length(), crc);
+    }
+
+    void vLog::restoreValue(const def::vLogEntry& entry, std::string& stored_value) {
+        if (entry.start != def::compressed_start_sign) return;
+        std::string value;
+        compression::decompress(static_cast<def::compression_type>(entry.compression), 
+            stored_value, value, entry.raw_length);
+        stored_value.swap(value);
+    }
 
-        // head = file_stream.tellp();
-        head = start_pos + def::v_log_fixed_size + dynamic_size;
+    uint64_t vLog::writeIntoFile() {
+        // the file is only appended, so the end is always head
+        uint64_t start_pos = head;
+        file_stream.seekp(start_pos, std::ios::beg);
+
+        // write into file using fstream in one shot, and keep the buffer for reuse
+        file_stream.write(write_buffer.data(), write_buffer.size());
+        head = start_pos + write_buffer.size();
+        write_buffer.clear();
 
         return start_pos;
     }
@@ -150,60 +210,71 @@ namespace vlog {
         file_stream.seekg(offset, std::ios::beg);
         def::vLogEntry entry{};
 
-        // read from file
-        size_t length = def::v_log_fixed_size + vlen;
-        char* read_buffer = new char[length + 1];
-        file_stream.read(read_buffer, length);
-        read_buffer[length] = '\0';
+        // the start sign tells the size of the rest of the fixed part
+        char read_buffer[def::compressed_v_log_fixed_size];
+        file_stream.read(read_buffer, sizeof(def::start_sign));
+        size_t fixed_size = def::vLogFixedSize(read_buffer[0]);
+        assert(fixed_size);
+        file_stream.read(read_buffer + sizeof(def::start_sign), 
+            fixed_size - sizeof(def::start_sign));
+        readEntryHeader(read_buffer, entry);
 
-        // assign read data to the entry
-        size_t cur_pos = 0;
-        // read each part of content from the file
-        def::read_from_buffer((char*)&entry.start, (char*)read_buffer, 
-            sizeof(entry.start), cur_pos);
-        def::read_from_buffer((char*)&entry.cycSum, (char*)read_buffer, 
-            sizeof(entry.cycSum), cur_pos);
-        // variable for validating data
-        size_t buffer_start = cur_pos;
-        def::read_from_buffer((char*)&entry.key, (char*)read_buffer, 
-            sizeof(entry.key), cur_pos);
-        def::read_from_buffer((char*)&entry.value_length, (char*)read_buffer, 
-            sizeof(entry.value_length), cur_pos);
-        entry.value = std::string(read_buffer + def::v_log_fixed_size);
+        // the value is read into its string directly
+        entry.value.resize(vlen);
+        file_stream.read(entry.value.data(), vlen);
 
         // check if ok
-        std::vector<unsigned char> united_entry(read_buffer + buffer_start, read_buffer + length);
-        delete [] read_buffer;
+        assert(entry.value_length == vlen);
+        assert(validEntry(read_buffer, entry.value));
+        restoreValue(entry, entry.value);
 
-        // start sign
-        assert(entry.start == def::start_sign);
-        // cycSum
-        assert(entry.cycSum == utils::crc16(united_entry));
-
-        return std::make_pair(entry.key, entry.value);
+        return std::make_pair(entry.key, std::move(entry.value));
     }
 
     uint64_t vLog::append(const key_type& key, const value_type& val) {
-        def::vLogEntry entry {
-            def::start_sign,
-            0,  // calculated later
-            key,
-            static_cast<uint32_t>(val.length()),
-            val,
-        };
-
-        return writeIntoFile(entry);
+        std::lock_guard<std::mutex> lock(file_mutex);
+
+        serializeEntry(key, val, def::compression_type::none);
+        return writeIntoFile();
+    }
+
+    std::vector<entry_location> vLog::appendBatch(
+        const std::vector<std::pair<key_type, std::string_view>>& entries, 
+        def::compression_type compression) {
+        std::lock_guard<std::mutex> lock(file_mutex);
+
+        // all entries are serialized into one buffer for a single write, and each of them
+        // is relative to the first one until then
+        std::vector<entry_location> locations;
+        locations.reserve(entries.size());
+        for (const auto& [key, val] : entries) {
+            uint64_t offset = write_buffer.size();
+            locations.emplace_back(offset, serializeEntry(key, val, compression));
+        }
+        uint64_t base_offset = writeIntoFile();
+        for (entry_location& location : locations) location.first += base_offset;
+        return locations;
     }
 
     std::pair<key_type, value_type> vLog::get(uint64_t offset, uint32_t vlen) {
+        std::lock_guard<std::mutex> lock(file_mutex);
         return readFromFile(offset, vlen);
     }
 
     void vLog::flush() {
+        std::lock_guard<std::mutex> lock(file_mutex);
+        file_stream.flush();
+    }
+
+    void vLog::sync() {
+        std::lock_guard<std::mutex> lock(file_mutex);
         file_stream.flush();
+        if (utils::syncFile(file_name) != 0) throw exception::vlog_io_error();
     }
 
     void vLog::clear() {
+        std::lock_guard<std::mutex> lock(file_mutex);
+
         // close and then delete the file
         file_stream.close();
         utils::rmfile(file_name);
@@ -217,8 +288,11 @@ namespace vlog {
     }
 
     std::vector<garbage_unit> vLog::getGCReinsertion(uint64_t chunk_size) {
+        std::lock_guard<std::mutex> lock(file_mutex);
+
         // read one more vLog entry
-        uint64_t read_buffer_size = std::min(chunk_size + def::v_log_fixed_size, head - tail);
+        uint64_t read_buffer_size = std::min(chunk_size + def::compressed_v_log_fixed_size, 
+            head - tail);
         uint64_t max_pos_allowed = std::min(chunk_size, head - tail);
 
         // read from file
@@ -236,34 +310,24 @@ namespace vlog {
             uint64_t offset = cur_pos;
             def::vLogEntry entry;
 
-            // read each part of content from the file
-            def::read_from_buffer((char*)&entry.start, (char*)read_buffer, 
-                sizeof(entry.start), cur_pos);
-            def::read_from_buffer((char*)&entry.cycSum, (char*)read_buffer, 
-                sizeof(entry.cycSum), cur_pos);
-            def::read_from_buffer((char*)&entry.key, (char*)read_buffer, 
-                sizeof(entry.key), cur_pos);
-            def::read_from_buffer((char*)&entry.value_length, (char*)read_buffer, 
-                sizeof(entry.value_length), cur_pos);
+            // read each part of content from the file, whose size depends on its version
+            cur_pos += readEntryHeader(read_buffer + cur_pos, entry);
 
             // read value of the entry
-            char* val = new char[entry.value_length + 1];
-            val[entry.value_length] = '\0';
-
             if (cur_pos + entry.value_length <= read_buffer_size) {
                 // read from buffer
-                memcpy(val, read_buffer + cur_pos, entry.value_length);
+                entry.value.assign(read_buffer + cur_pos, entry.value_length);
             }
             else {
                 // read from file
+                entry.value.resize(entry.value_length);
                 file_stream.seekg(tail + cur_pos, std::ios::beg);
-                file_stream.read(val, entry.value_length);
+                file_stream.read(entry.value.data(), entry.value_length);
             }
 
-            // assign value and update cur_pos
-            entry.value = val;
-            delete [] val;
+            // update cur_pos, and the value is reinserted as it was put
             cur_pos += entry.value_length;
+            restoreValue(entry, entry.value);
 
             // TODO: assertion may be needed? however I don't wanna do it now
 
@@ -279,6 +343,8 @@ namespace vlog {
     }
 
     void vLog::garbageCollection() {
+        std::lock_guard<std::mutex> lock(file_mutex);
+
         // separate this function apart to prevent the hazard caused accidental interruption
         utils::de_alloc_file(file_name, tail, garbage_to_collect);
         tail += garbage_to_collect;
@@ -3,8 +3,12 @@
 #include <cstddef>
 #include <cstdint>
 #include <fstream>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <vector>
 #include "../common/definitions.h"
+#include "../common/options.h"
 #include "../utils.h"
 
 namespace vlog {
@@ -13,20 +17,44 @@ namespace vlog {
     using def::value_type;
     using garbage_unit = std::pair<def::vLogEntry, uint64_t>;
 
+    // the offset of an entry and the bytes its value takes in vLog, which is what is
+    // read back by get
+    using entry_location = std::pair<uint64_t, uint32_t>;
+
     class vLog
     {
     private:
         std::string file_name;
         std::fstream file_stream;
 
+        // readers and the flushing thread share one file stream
+        std::mutex file_mutex;
+
         // tail and head of LSMTree
         std::uint64_t tail = 0, head = 0;
         void initialize();
 
         void createAndOpenFile();
 
-        // use this function to deal with different types of key-value pair
-        uint64_t writeIntoFile(def::vLogEntry& entry);
+        // the buffers entries are serialized and values are compressed into before
+        // written, which are reused
+        std::string write_buffer, compressed_value;
+
+        // use these functions to deal with different types of key-value pair, and the
+        // bytes the value takes are returned
+        uint32_t serializeEntry(const key_type& key, std::string_view val, 
+            def::compression_type compression);
+
+        // read the fixed part of an entry of any version, and return its size
+        static size_t readEntryHeader(const char* src, def::vLogEntry& entry);
+
+        // whether the checksum in the fixed part at src matches the rest of it and the
+        // value as stored, which are checked where they are without joining them
+        static bool validEntry(const char* src, std::string_view value);
+
+        // the value as it was put, which is decompressed if needed
+        static void restoreValue(const def::vLogEntry& entry, std::string& stored_value);
+        uint64_t writeIntoFile();
         std::pair<key_type, value_type> readFromFile(uint64_t offset, uint32_t vlen);
 
         // some variables for garbage collection under multi-process
@@ -37,9 +65,19 @@ namespace vlog {
         ~vLog();
 
         uint64_t append(const key_type& key, const value_type& val);
+
+        // write all entries at once, each of whose values is compressed with the codec if
+        // it shrinks, and returns where each of them is
+        std::vector<entry_location> appendBatch(
+            const std::vector<std::pair<key_type, std::string_view>>& entries, 
+            def::compression_type compression = def::compression_type::none);
         std::pair<key_type, value_type> get(uint64_t offset, uint32_t vlen);
         void flush();
 
+        // flush and force the entries onto the disk, which must be done before the logs of
+        // the values written so far are removed
+        void sync();
+
         void clear();
 
         std::vector<garbage_unit> getGCReinsertion(uint64_t chunk_size);
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include "wal.h"
+#include "../common/exceptions.h"
+#include "../utils.h"
+
+namespace wal {
+
+    writeAheadLog::writeAheadLog(const std::string& dir, wal_sync_policy policy,
+        size_t sync_interval_ms) : policy(policy), sync_interval(sync_interval_ms) {
+        // use a safer way to manage file path
+        std::filesystem::path path(dir);
+        path.append(def::wal_directory_name);
+        directory = path.string();
+
+        // create directory first
+        if (utils::mkdir(directory) != 0) {
+            throw exception::create_directory_fail();
+        }
+
+        // the logs are named by increasing numbers
+        std::vector<std::string> files;
+        std::vector<uint64_t> numbers;
+        utils::scanDir(directory, files);
+        for (const std::string& file : files) {
+            std::filesystem::path file_path(file);
+            if (file_path.extension() != def::wal_extension_name) continue;
+            numbers.push_back(std::stoull(file_path.stem().string()));
+        }
+        std::sort(numbers.begin(), numbers.end());
+        for (uint64_t number : numbers) {
+            recovered_logs.push_back(logName(number));
+        }
+
+        // a new file never mixes with the old ones
+        log_number = numbers.empty() ? 0 : numbers.back() + 1;
+        openLog();
+
+        if (policy == wal_sync_policy::interval) {
+            sync_thread = std::thread(&writeAheadLog::backgroundSync, this);
+        }
+    }
+
+    writeAheadLog::~writeAheadLog() {
+        {
+            std::unique_lock<std::mutex> lock(log_mutex);
+            stop_syncing = true;
+        }
+        sync_cv.notify_all();
+        if (sync_thread.joinable()) sync_thread.join();
+
+        // nothing is left for the next run if the file is empty
+        struct stat st;
+        bool empty = fstat(fd, &st) == 0 && st.st_size == 0;
+        if (!empty && policy != wal_sync_policy::never) syncLog();
+        close(fd);
+        if (empty) utils::rmfile(file_name);
+    }
+
+    std::string writeAheadLog::logName(uint64_t number) const {
+        std::filesystem::path path(directory);
+        path.append(std::to_string(number) + def::wal_extension_name);
+        return path.string();
+    }
+
+    void writeAheadLog::openLog() {
+        file_name = logName(log_number);
+        fd = open(file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) {
+            perror("open");
+            throw exception::wal_io_error();
+        }
+
+        // a synced record is lost with its file unless the new name is synced too
+        if (policy != wal_sync_policy::never && utils::syncDir(directory) != 0) {
+            throw exception::wal_io_error();
+        }
+    }
+
+    void writeAheadLog::writeOut(const std::string& buffer) {
+        // write may return early, so loop until all bytes are written
+        size_t written = 0;
+        while (written < buffer.size()) {
+            ssize_t result = write(fd, buffer.data() + written, buffer.size() - written);
+            if (result < 0) {
+                if (errno == EINTR) continue;
+                perror("write");
+                throw exception::wal_io_error();
+            }
+            written += result;
+        }
+    }
+
+    void writeAheadLog::syncLog() {
+        // only the data matters, the metadata is not needed for reading it back
+        if (fdatasync(fd) != 0) {
+            perror("fdatasync");
+            throw exception::wal_io_error();
+        }
+    }
+
+    void writeAheadLog::backgroundSync() {
+        std::unique_lock<std::mutex> lock(log_mutex);
+        auto deadline = std::chrono::steady_clock::now() + sync_interval;
+        while (true) {
+            // appenders don't wake this thread up, only the deadline or stopping does
+            if (sync_cv.wait_until(lock, deadline, [this]() { return stop_syncing; })) return;
+            deadline += sync_interval;
+
+            // nothing new since the last sync
+            waitForIdle(lock);
+            if (synced_sequence == written_sequence) continue;
+
+            // sync without blocking appenders, who are only excluded from writing
+            uint64_t sequence = written_sequence;
+            writing = true;
+            lock.unlock();
+            syncLog();
+            lock.lock();
+            writing = false;
+            synced_sequence = sequence;
+            ++sync_count;
+            log_cv.notify_all();
+        }
+    }
+
+    void writeAheadLog::waitForIdle(std::unique_lock<std::mutex>& lock) {
+        log_cv.wait(lock, [this]() { return !writing; });
+    }
+
+    void writeAheadLog::encode(std::string& payload, const key_type& key,
+        const entry_view& entry) {
+        uint32_t value_length = static_cast<uint32_t>(entry.value.length());
+        payload.append(reinterpret_cast<const char*>(&key), sizeof(key));
+        payload.push_back(static_cast<char>(entry.kind));
+        payload.append(reinterpret_cast<const char*>(&value_length), sizeof(value_length));
+        payload.append(entry.value);
+    }
+
+    void writeAheadLog::decode(const std::string& payload, const entry_visitor& visitor) {
+        size_t pos = 0;
+        while (pos < payload.size()) {
+            key_type key;
+            entry_kind kind;
+            uint32_t value_length;
+            def::read_from_buffer((char*)&key, (char*)payload.data(), sizeof(key), pos);
+            def::read_from_buffer((char*)&kind, (char*)payload.data(), sizeof(kind), pos);
+            def::read_from_buffer((char*)&value_length, (char*)payload.data(),
+                sizeof(value_length), pos);
+            visitor(key, entry_view{ kind, value_view(payload).substr(pos, value_length) });
+            pos += value_length;
+        }
+    }
+
+    void writeAheadLog::append(const std::string& payload) {
+        // the header makes a torn record detectable
+        uint32_t length = static_cast<uint32_t>(payload.length());
+        uint16_t check_sum = utils::crc16((const unsigned char*)payload.data(), length);
+        bool need_sync = policy == wal_sync_policy::every_write;
+
+        std::unique_lock<std::mutex> lock(log_mutex);
+        if (broken) throw exception::wal_io_error();
+        pending.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        pending.append(reinterpret_cast<const char*>(&check_sum), sizeof(check_sum));
+        pending.append(payload);
+        uint64_t sequence = ++appended_sequence;
+        std::shared_ptr<groupState> state = pending_group;
+
+        while (!state->failed && 
+            (written_sequence < sequence || (need_sync && synced_sequence < sequence))) {
+            // some leader is writing, whose group may or may not include this record
+            if (writing) {
+                log_cv.wait(lock);
+                continue;
+            }
+
+            // become the leader, and write out all records appended so far in one shot,
+            // so that concurrent writers share one write and one sync
+            std::string group;
+            group.swap(pending);
+            std::shared_ptr<groupState> group_state = std::move(pending_group);
+            pending_group = std::make_shared<groupState>();
+            uint64_t group_sequence = appended_sequence;
+            uint64_t group_start = log_size;
+            writing = true;
+            lock.unlock();
+
+            try {
+                writeOut(group);
+                if (need_sync) syncLog();
+            }
+            catch (...) {
+                // a part of the group may be in the file, which would hide the records
+                // after it from replay, so it's cut off
+                bool truncated = ftruncate(fd, group_start) == 0;
+                if (!truncated) perror("ftruncate");
+
+                // every writer of the group fails, while the later ones go on
+                lock.lock();
+                group_state->failed = true;
+                broken = broken || !truncated;
+                writing = false;
+                log_cv.notify_all();
+                throw;
+            }
+
+            lock.lock();
+            writing = false;
+            log_size += group.size();
+            written_sequence = group_sequence;
+            if (need_sync) {
+                synced_sequence = group_sequence;
+                ++sync_count;
+            }
+            log_cv.notify_all();
+        }
+
+        // the group of the record failed under another leader
+        if (state->failed) throw exception::wal_io_error();
+    }
+
+    std::string writeAheadLog::rotate() {
+        std::unique_lock<std::mutex> lock(log_mutex);
+        waitForIdle(lock);
+        // every append has returned before its table becomes immutable
+        assert(pending.empty());
+
+        // the sealed file stays until its table is in SSTables
+        if (policy != wal_sync_policy::never && synced_sequence < written_sequence) {
+            syncLog();
+            synced_sequence = written_sequence;
+            ++sync_count;
+        }
+        close(fd);
+
+        std::string sealed_name = file_name;
+        ++log_number;
+        openLog();
+        log_size = 0;
+        broken = false;
+        return sealed_name;
+    }
+
+    void writeAheadLog::clear() {
+        std::unique_lock<std::mutex> lock(log_mutex);
+        waitForIdle(lock);
+
+        // the file is opened with O_APPEND, so the next record starts from zero
+        if (ftruncate(fd, 0) != 0) {
+            perror("ftruncate");
+            throw exception::wal_io_error();
+        }
+        pending.clear();
+        written_sequence = synced_sequence = appended_sequence;
+        log_size = 0;
+        broken = false;
+    }
+
+    void writeAheadLog::replay(const std::string& file_name, const entry_visitor& visitor) {
+        // a log is no larger than a memTable, so read it at once
+        std::ifstream file_stream(file_name, std::ios::binary);
+        std::string buffer((std::istreambuf_iterator<char>(file_stream)),
+            std::istreambuf_iterator<char>());
+
+        size_t pos = 0;
+        while (pos + record_header_size <= buffer.size()) {
+            uint32_t length;
+            uint16_t check_sum;
+            def::read_from_buffer((char*)&length, buffer.data(), sizeof(length), pos);
+            def::read_from_buffer((char*)&check_sum, buffer.data(), sizeof(check_sum), pos);
+
+            // the record is torn by a crash
+            if (pos + length > buffer.size()) return;
+            if (utils::crc16((const unsigned char*)buffer.data() + pos, length) != check_sum) {
+                return;
+            }
+
+            // the payload is complete, so all entries in it are replayed
+            decode(buffer.substr(pos, length), visitor);
+            pos += length;
+        }
+    }
+
+    size_t writeAheadLog::syncCount() {
+        std::unique_lock<std::mutex> lock(log_mutex);
+        return sync_count;
+    }
+
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../common/definitions.h"
+#include "../common/options.h"
+
+namespace wal {
+
+    using def::key_type;
+    using def::value_type;
+    using def::value_view;
+    using def::entry_kind;
+    using def::entry_view;
+    using def::wal_sync_policy;
+
+    // called with each entry of the records in the order they were appended
+    using entry_visitor = std::function<void(const key_type&, const entry_view&)>;
+
+    // a record is a uint32_t payload length, a crc16 of the payload and the payload,
+    // which holds one or more entries that are replayed all or nothing, and each entry
+    // is the key, the kind, the value length and the value
+    const size_t record_header_size = sizeof(uint32_t) + sizeof(uint16_t);
+
+    // ATTENTION! each memTable has its own log file, which is sealed by rotate when the
+    // table becomes immutable and can be removed once the table is in SSTables
+    class writeAheadLog
+    {
+    private:
+        std::string directory;
+        wal_sync_policy policy;
+        std::chrono::milliseconds sync_interval;
+
+        // the file accepting records
+        uint64_t log_number = 0;
+        std::string file_name;
+        int fd = -1;
+
+        // the logs found on construction, which are left by the last run
+        std::vector<std::string> recovered_logs;
+
+        // whether the write or the sync of a group failed, which is shared by all writers
+        // whose records are in the group, since none of them is done then
+        struct groupState {
+            bool failed = false;
+        };
+
+        // records wait in pending until a leader writes them out for the whole group,
+        // and the sequences tell each writer whether its record is done
+        std::mutex log_mutex;
+        std::condition_variable log_cv;
+        std::string pending;
+        std::shared_ptr<groupState> pending_group = std::make_shared<groupState>();
+        uint64_t appended_sequence = 0, written_sequence = 0, synced_sequence = 0;
+        bool writing = false;
+        size_t sync_count = 0;
+
+        // the bytes of the complete records in the file, which a failed group is cut back
+        // to, and if even that fails, no record may follow it until the file is replaced
+        uint64_t log_size = 0;
+        bool broken = false;
+
+        // the thread syncing records with wal_sync_policy::interval
+        std::thread sync_thread;
+        std::condition_variable sync_cv;
+        bool stop_syncing = false;
+
+        std::string logName(uint64_t number) const;
+        void openLog();
+        void writeOut(const std::string& buffer);
+        void syncLog();
+        void backgroundSync();
+
+        // ATTENTION! the caller must hold log_mutex, and no one else writes or syncs then
+        void waitForIdle(std::unique_lock<std::mutex>& lock);
+
+    public:
+        writeAheadLog(const std::string& dir, wal_sync_policy policy, size_t sync_interval_ms);
+        ~writeAheadLog();
+
+        writeAheadLog(const writeAheadLog&) = delete;
+        writeAheadLog& operator=(const writeAheadLog&) = delete;
+
+        // append an entry to a payload, and visit all entries in a payload
+        static void encode(std::string& payload, const key_type& key, const entry_view& entry);
+        static void decode(const std::string& payload, const entry_visitor& visitor);
+
+        // returns once the record is as durable as the policy requires, or throws
+        // wal_io_error if the record isn't written
+        void append(const std::string& payload);
+
+        // seal the current file, which is returned, and start a new one
+        std::string rotate();
+
+        // drop all records in the current file
+        void clear();
+
+        // the logs left by the last run from the oldest to the newest
+        const std::vector<std::string>& recoveredLogs() const { return recovered_logs; }
+
+        // replay all complete records, a torn record at the end is ignored
+        static void replay(const std::string& file_name, const entry_visitor& visitor);
+
+        size_t syncCount();
+    };
+
+}
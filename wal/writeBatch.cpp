@@ -0,0 +1,25 @@
+#include "writeBatch.h"
+
+namespace wal {
+
+    void writeBatch::put(const key_type& key, const value_type& value) {
+        writeAheadLog::encode(payload, key, entry_view{ entry_kind::value, value });
+        ++entry_number;
+    }
+
+    void writeBatch::del(const key_type& key) {
+        // a delete is a tombstone without looking up the key, unlike KVStore::del
+        writeAheadLog::encode(payload, key, entry_view{ entry_kind::tombstone, value_view() });
+        ++entry_number;
+    }
+
+    void writeBatch::clear() {
+        payload.clear();
+        entry_number = 0;
+    }
+
+    void writeBatch::forEach(const entry_visitor& visitor) const {
+        writeAheadLog::decode(payload, visitor);
+    }
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "wal.h"
+
+namespace wal {
+
+    // many puts and deletes applied all or nothing, which are encoded as one record
+    // of the write-ahead log as soon as they are added
+    class writeBatch
+    {
+    private:
+        std::string payload;
+        size_t entry_number = 0;
+
+    public:
+        void put(const key_type& key, const value_type& value);
+        void del(const key_type& key);
+        void clear();
+
+        // visit the entries in the order they were added
+        void forEach(const entry_visitor& visitor) const;
+
+        size_t size() const { return entry_number; }
+        bool empty() const { return entry_number == 0; }
+
+        // the record appended to the log
+        const std::string& getPayload() const { return payload; }
+    };
+
+}